@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+# encoding: utf-8
+
+# Dump reference inputs/outputs of the learned ds of a demo, evaluated by the python models exactly as
+# first_ds_control.py and second_ds_control.py do. src/tools/ds_parity.cpp checks the native evaluator
+# (src/learn_embedding/dynamics) against them.
+#
+# python scripts/ds_golden.py [demo] [samples]
+# writes rsc/demos/demo_N/models/golden_first.csv (x, dx) and golden_second.csv (x, dx, ddx)
+
+import os
+import sys
+import numpy as np
+import torch
+import yaml
+
+from learn_embedding.utils import *
+from learn_embedding.dynamics import FirstGeometry, SecondGeometry
+from learn_embedding.embedding import Embedding
+from learn_embedding.covariances import *
+from learn_embedding.approximators import *
+
+demo_number = sys.argv[1] if len(sys.argv) >= 2 else "2"
+samples = int(sys.argv[2]) if len(sys.argv) >= 3 else 200
+folder = "rsc/demos/demo_" + demo_number
+
+# load params
+with open(folder + "/dynamics_params.yaml", "r") as yamlfile:
+    p = yaml.load(yamlfile, Loader=yaml.SafeLoader)
+dim = p['dimension']
+
+
+def first_order():
+    approximator = FeedForward(dim, [p['first_order']['embedding']['params'][0]]*p['first_order']['embedding']['params'][1], 1)
+    model = FirstGeometry(Embedding(approximator), torch.zeros(dim), SPD(dim))
+    TorchHelper.load(model, folder + "/models/" + p['first_order']['name'], "cpu")
+    return model
+
+
+def second_order():
+    approximator = FeedForward(dim, [p['second_order']['embedding']['params'][0]]*p['second_order']['embedding']['params'][1], 1)
+    model = SecondGeometry(Embedding(approximator), torch.zeros(dim), SPD(dim), SPD(dim))
+    TorchHelper.load(model, folder + "/models/" + p['second_order']['name'], "cpu")
+    if p['second_order']['options']['directional_dissipation']:
+        model.field = first_order()
+        model.field_weight = p['second_order']['options']['field_weight']
+    return model
+
+
+# inputs: points along the demonstrations (stored relative to the attractor) and, for the second order, velocities
+offset = np.array(p["offset"])
+points = np.concatenate([np.loadtxt(folder + "/trajectory_" + str(i) + ".csv") for i in range(1, 100)
+                         if os.path.isfile(folder + "/trajectory_" + str(i) + ".csv")])
+rng = np.random.default_rng(0)
+x = points[rng.choice(points.shape[0], samples, replace=False)] + offset
+v = rng.uniform(-0.5, 0.5, (samples, dim))
+
+# outputs, same calls as the model servers
+y = first_order()(torch.tensor(x - offset).float().requires_grad_(True)).detach().to(dtype=torch.float64).numpy()
+np.savetxt(folder + "/models/golden_first.csv", np.concatenate((x, y), axis=1))
+
+state = np.concatenate((x - offset, v), axis=1)
+y = second_order().forward_fast(torch.tensor(state).float().requires_grad_(True)).detach().to(dtype=torch.float64).numpy()
+np.savetxt(folder + "/models/golden_second.csv", np.concatenate((x, v, y), axis=1))
@@ -5,16 +5,16 @@ import sys
 import numpy as np
 import torch
 import yaml
-import time
 
-from zmq_stream.replier import Replier
+from wire_stream import WireReplier
+from shm_stream import ShmReplier
 from learn_embedding.utils import *
 from learn_embedding.dynamics import FirstGeometry
 from learn_embedding.embedding import Embedding
 from learn_embedding.covariances import *
 from learn_embedding.approximators import *
 
-demo_number = sys.argv[1] if len(sys.argv) == 2 else "1"
+demo_number = sys.argv[1] if len(sys.argv) >= 2 else "1"
 
 # load params
 with open("rsc/demos/demo_" + demo_number + "/dynamics_params.yaml", "r") as yamlfile:
@@ -34,15 +34,20 @@ TorchHelper.load(model, "rsc/demos/demo_" + demo_number + "/models/"+p['first_or
 
 # callback
 offset = torch.from_numpy(np.array(p["offset"])).float().to(device)
+# x may hold several states (horizon-batched request), evaluated in one pass
 def dynamics(x):
-    t0 = time.time()
-    x = torch.tensor(x[np.newaxis, :]).float().requires_grad_(True).to(device) - offset
-    y = model(x).cpu().detach().squeeze().to(dtype=torch.float64).numpy()
-    print(time.time()-t0)
+    x = torch.tensor(x.reshape(-1, p["dimension"])).float().requires_grad_(True).to(device) - offset
+    y = model(x).cpu().detach().reshape(-1).to(dtype=torch.float64).numpy()
     return y
 
-# communicator
-rep = Replier()
-rep.configure("0.0.0.0", "5511")
+# communicator (transport as in the C++ controllers: second argument or "stream" section)
+stream = p.get("stream", {})
+transport = sys.argv[2] if len(sys.argv) >= 3 else stream.get("transport", "zmq")
+if transport == "shm":
+    rep = ShmReplier()
+    rep.configure(stream.get("shm", "ds_stream"))
+else:
+    rep = WireReplier()
+    rep.configure("0.0.0.0", "5511")
 while True:
     x = rep.reply(dynamics, np.float64, 3)
@@ -5,16 +5,16 @@ import sys
 import numpy as np
 import torch
 import yaml
-import time
 
-from zmq_stream.replier import Replier
+from wire_stream import WireReplier
+from shm_stream import ShmReplier
 from learn_embedding.utils import *
 from learn_embedding.dynamics import FirstGeometry, SecondGeometry
 from learn_embedding.embedding import Embedding
 from learn_embedding.covariances import *
 from learn_embedding.approximators import *
 
-demo_number = sys.argv[1] if len(sys.argv) == 2 else "1"
+demo_number = sys.argv[1] if len(sys.argv) >= 2 else "1"
 
 # load params
 with open("rsc/demos/demo_" + demo_number + "/dynamics_params.yaml", "r") as yamlfile:
@@ -41,22 +41,27 @@ if p['second_order']['options']['directional_dissipation']:
     model_first = FirstGeometry(Embedding(approximator_first), torch.zeros(p["dimension"]).to(device), stiffness_first).to(device)
     TorchHelper.load(model_first, "rsc/demos/demo_" + demo_number + "/models/"+p['first_order']['name'], device)
     model.field = model_first
-    model.field_weight = 15.0
+    model.field_weight = p['second_order']['options']['field_weight']
 
 # callback
 offset = np.concatenate((p["offset"], np.zeros(p['dimension'])))[np.newaxis, :]
 
 
+# x may hold several states (horizon-batched request), evaluated in one pass
 def dynamics(x):
-    x = torch.tensor(x[np.newaxis, :] - offset).float().requires_grad_(True).to(device)
-    t0 = time.time()
-    y = model.forward_fast(x).cpu().detach().squeeze().to(dtype=torch.float64).numpy()
-    print(time.time()-t0)
+    x = torch.tensor(x.reshape(-1, offset.shape[1]) - offset).float().requires_grad_(True).to(device)
+    y = model.forward_fast(x).cpu().detach().reshape(-1).to(dtype=torch.float64).numpy()
     return y
 
 
-# communicator
-rep = Replier()
-rep.configure("0.0.0.0", "5511")
+# communicator (transport as in the C++ controllers: second argument or "stream" section)
+stream = p.get("stream", {})
+transport = sys.argv[2] if len(sys.argv) >= 3 else stream.get("transport", "zmq")
+if transport == "shm":
+    rep = ShmReplier()
+    rep.configure(stream.get("shm", "ds_stream"))
+else:
+    rep = WireReplier()
+    rep.configure("0.0.0.0", "5511")
 while True:
     x = rep.reply(dynamics, np.float64, 6)
@@ -0,0 +1,36 @@
+#!/usr/bin/env python
+# encoding: utf-8
+
+import time
+import numpy as np
+import zmq
+
+# layout of learn_embedding/stream/Message.hpp
+HEADER = np.dtype([("sequence", np.uint64), ("stamp", np.int64), ("dim", np.uint32), ("flags", np.uint32),
+                   ("queue", np.uint32), ("compute", np.uint32)])
+
+
+class WireReplier:
+    """zmq replier speaking the fixed-layout Message format of the C++ WireRequester."""
+
+    def configure(self, host, port):
+        self.context_ = zmq.Context()
+        self.socket_ = self.context_.socket(zmq.REP)
+        self.socket_.bind("tcp://" + host + ":" + port)
+
+    def reply(self, fn, dtype, dim):
+        message = self.socket_.recv(copy=False).buffer
+        header = np.frombuffer(message, dtype=HEADER, count=1).copy()
+        x = np.frombuffer(message, dtype=np.float64, count=int(header["dim"][0]), offset=HEADER.itemsize).astype(dtype)
+
+        t0 = time.perf_counter_ns()
+        y = np.ascontiguousarray(fn(x), dtype=np.float64).reshape(-1)
+        compute = time.perf_counter_ns() - t0
+
+        # sequence and stamp are sent back untouched, along with the evaluation time
+        header["dim"] = y.shape[0]
+        header["queue"] = 0
+        header["compute"] = min(compute, 0xFFFFFFFF)
+        self.socket_.send(header.tobytes() + y.tobytes())
+
+        return x
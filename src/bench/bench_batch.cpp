@@ -0,0 +1,82 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Throughput of flange pose + Jacobian over many configurations: FrankaModel one sample at a time (pinocchio and kernel
+// paths) against PandaBatch (SIMD across samples, single thread and all cores), with the largest deviation of the batch
+// from the per-sample kernel. Run from the repository root (the urdf path is relative).
+
+// Model
+#include "learn_embedding/model/FrankaModel.hpp"
+#include "learn_embedding/model/PandaBatch.hpp"
+
+#include <chrono>
+#include <iostream>
+
+using namespace learn_embedding;
+using namespace std::chrono;
+
+int main(int argc, char const* argv[])
+{
+    size_t num_samples = (argc > 1) ? std::stoul(argv[1]) : 100000;
+
+    model::FrankaModel<7> franka;
+    model::PandaBatch::Joints q(num_samples, 7);
+    for (size_t i = 0; i < num_samples; i++)
+        q.row(i) = (franka.positionLower() + (Eigen::VectorXd::Random(7) + Eigen::VectorXd::Ones(7)).cwiseProduct(franka.positionUpper() - franka.positionLower()) * 0.5).transpose();
+
+    Eigen::MatrixXd positions(num_samples, 3), rotations(num_samples, 9), jacobians(num_samples, 42);
+    model::FrankaModel<7>::Configuration config;
+
+    auto loop = [&]() {
+        auto start = steady_clock::now();
+        for (size_t i = 0; i < num_samples; i++) {
+            config = q.row(i).transpose();
+            positions.row(i) = franka.framePose(config).head<3>().transpose();
+            jacobians.row(i) = Eigen::Map<const Eigen::Matrix<double, 1, 42>>(franka.jacobian(config).data());
+        }
+        return num_samples / duration<double>(steady_clock::now() - start).count();
+    };
+
+    franka.setKernel(false);
+    double pinocchio_rate = loop();
+    franka.setKernel(true);
+    double kernel_rate = loop();
+    Eigen::MatrixXd reference = jacobians, reference_positions = positions;
+
+    auto start = steady_clock::now();
+    model::PandaBatch::jacobian(q, positions, rotations, jacobians, 1);
+    double single_rate = num_samples / duration<double>(steady_clock::now() - start).count();
+
+    start = steady_clock::now();
+    model::PandaBatch::jacobian(q, positions, rotations, jacobians);
+    double batch_rate = num_samples / duration<double>(steady_clock::now() - start).count();
+
+    std::cout << "per-sample pinocchio " << pinocchio_rate << " [samples/s]" << std::endl;
+    std::cout << "per-sample kernel " << kernel_rate << " [samples/s]" << std::endl;
+    std::cout << "batch 1 thread " << single_rate << " [samples/s] x" << single_rate / pinocchio_rate << std::endl;
+    std::cout << "batch " << std::thread::hardware_concurrency() << " threads " << batch_rate << " [samples/s] x" << batch_rate / pinocchio_rate << std::endl;
+    std::cout << "batch vs kernel max error " << std::max((jacobians - reference).cwiseAbs().maxCoeff(), (positions - reference_positions).cwiseAbs().maxCoeff()) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Closed-form Panda kernel against pinocchio for the panda_joint8 frame: cross-check on random configurations within the
+// joint limits (rotation, position, Jacobian and its derivative), then time per evaluation of pose alone and of
+// pose + Jacobian + derivative. Run from the repository root (the urdf path is relative).
+
+// Model
+#include "learn_embedding/model/FrankaModel.hpp"
+#include "learn_embedding/model/PandaKinematics.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace learn_embedding;
+using namespace std::chrono;
+
+int main(int argc, char const* argv[])
+{
+    size_t num_samples = (argc > 1) ? std::stoul(argv[1]) : 100000;
+
+    model::FrankaModel<7> franka;
+    std::cout << "cross-check max error " << franka.crossCheck(1000) << std::endl;
+
+    pinocchio::Model model;
+    pinocchio::urdf::buildModel("rsc/franka/panda.urdf", model);
+    pinocchio::Data data(model);
+    pinocchio::FrameIndex id = model.getFrameId("panda_joint8");
+
+    using Configuration = model::PandaKinematics::Configuration;
+    std::vector<Configuration> qs(num_samples), dqs(num_samples);
+    for (size_t i = 0; i < num_samples; i++) {
+        qs[i] = model.lowerPositionLimit + (Configuration::Random() + Configuration::Ones()).cwiseProduct(model.upperPositionLimit - model.lowerPositionLimit) * 0.5;
+        dqs[i] = Configuration::Random();
+    }
+
+    Eigen::Matrix3d R;
+    Eigen::Vector3d p;
+    model::PandaKinematics::Jacobian J, dJ;
+    double checksum = 0.0;
+
+    auto time = [&](const std::string& name, auto&& evaluate) {
+        auto start = steady_clock::now();
+        for (size_t i = 0; i < num_samples; i++) {
+            evaluate(qs[i], dqs[i]);
+            checksum += p(0);
+        }
+        std::cout << name << " " << duration<double, std::nano>(steady_clock::now() - start).count() / num_samples << " [ns]" << std::endl;
+    };
+
+    time("pinocchio pose", [&](const Configuration& q, const Configuration&) {
+        pinocchio::framesForwardKinematics(model, data, q);
+        p = data.oMf[id].translation();
+    });
+
+    time("kernel pose", [&](const Configuration& q, const Configuration&) {
+        model::PandaKinematics::pose(q, R, p);
+    });
+
+    time("pinocchio pose + J + dJ", [&](const Configuration& q, const Configuration& dq) {
+        pinocchio::computeJointJacobiansTimeVariation(model, data, q, dq);
+        pinocchio::updateFramePlacement(model, data, id);
+        pinocchio::getFrameJacobian(model, data, id, pinocchio::LOCAL_WORLD_ALIGNED, J);
+        pinocchio::getFrameJacobianTimeVariation(model, data, id, pinocchio::LOCAL_WORLD_ALIGNED, dJ);
+        p = data.oMf[id].translation();
+    });
+
+    time("kernel pose + J + dJ", [&](const Configuration& q, const Configuration& dq) {
+        model::PandaKinematics::jacobianDerivative(q, dq, R, p, J, dJ);
+    });
+
+    // keeps the loops from being optimized away
+    std::cout << "checksum " << checksum << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Per-tick cost of the Panda model terms used by the inverse dynamics controller: frame pose, frame velocity, gravity,
+// Jacobian, Jacobian derivative and nonlinear effects. "direct" queries MultiBody for every term, "cached pinocchio" lets
+// FrankaModel fill them in one pinocchio kinematic pass per (q, dq), "cached kernel" in one pass of the closed-form Panda
+// kernel (when the description enabled it). Each tick asks for every term twice, as controller and QP do.
+// Then the same ticks run on one workspace per thread, all sharing the model's description, and the operational-space
+// inertia is timed along a smooth 1 kHz joint trajectory, with M refactorized every tick and within a 1e-3 rad tolerance.
+// Run from the repository root (the urdf path is relative).
+
+// Model
+#include "learn_embedding/model/FrankaModel.hpp"
+#include "learn_embedding/tools/Histogram.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace learn_embedding;
+using namespace std::chrono;
+
+int main(int argc, char const* argv[])
+{
+    size_t num_ticks = (argc > 1) ? std::stoul(argv[1]) : 10000;
+
+    model::FrankaModel<> franka;
+    beautiful_bullet::bodies::MultiBody& body = franka;
+    Eigen::VectorXd q0 = (franka.positionUpper() + franka.positionLower()) * 0.5, q, dq;
+
+    Eigen::Matrix<double, 6, 1> pose, velocity;
+    Eigen::MatrixXd J, dJ;
+    Eigen::VectorXd g, nle;
+
+    // direct
+    tools::Histogram direct;
+    size_t direct_calls = 0;
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < num_ticks; i++) {
+        q = q0 + 0.1 * Eigen::VectorXd::Random(q0.size());
+        dq = Eigen::VectorXd::Random(q0.size());
+
+        auto tick = steady_clock::now();
+        for (size_t k = 0; k < 2; k++) {
+            pose = body.framePose(q, franka._frame);
+            velocity = body.frameVelocity(q, dq, franka._frame, franka._reference);
+            g = body.gravityVector(q);
+            J = body.jacobian(q, franka._frame, franka._reference);
+            dJ = body.jacobianDerivative(q, dq, franka._frame, franka._reference);
+            nle = body.nonLinearEffects(q, dq);
+            direct_calls += 6;
+        }
+        direct.record(duration_cast<nanoseconds>(steady_clock::now() - tick).count());
+    }
+    double direct_wall = duration<double>(steady_clock::now() - start).count();
+
+    // cached, one fused pass per tick; passes and hits are counted over this loop only
+    struct Cached {
+        tools::Histogram histogram;
+        double wall = 0.0, passes = 0.0, hits = 0.0;
+    };
+    auto cache = [&](const bool& kernel, Cached& cached) {
+        franka.setKernel(kernel);
+        size_t passes = franka.passes(), hits = franka.hits();
+        auto begin = steady_clock::now();
+        for (size_t i = 0; i < num_ticks; i++) {
+            q = q0 + 0.1 * Eigen::VectorXd::Random(q0.size());
+            dq = Eigen::VectorXd::Random(q0.size());
+
+            auto tick = steady_clock::now();
+            franka.update(q, dq);
+            for (size_t k = 0; k < 2; k++) {
+                pose = franka.framePose(q);
+                velocity = franka.frameVelocity(q, dq);
+                g = franka.gravityVector(q);
+                J = franka.jacobian(q);
+                dJ = franka.jacobianDerivative(q, dq);
+                nle = franka.nonLinearEffects(q, dq);
+            }
+            cached.histogram.record(duration_cast<nanoseconds>(steady_clock::now() - tick).count());
+        }
+        cached.wall = duration<double>(steady_clock::now() - begin).count();
+        cached.passes = double(franka.passes() - passes) / num_ticks;
+        cached.hits = double(franka.hits() - hits) / num_ticks;
+    };
+    bool kernel = franka.description()->kernel();
+    Cached pinocchio, closed;
+    cache(false, pinocchio);
+    if (kernel)
+        cache(true, closed);
+
+    // concurrent workspaces over one description
+    size_t num_threads = std::max(2u, std::thread::hardware_concurrency());
+    std::vector<model::FrankaModel<>::Configuration> qs(num_ticks), dqs(num_ticks);
+    std::vector<model::FrankaModel<>::Pose> reference(num_ticks);
+    for (size_t i = 0; i < num_ticks; i++) {
+        qs[i] = q0 + 0.1 * Eigen::VectorXd::Random(q0.size());
+        dqs[i] = Eigen::VectorXd::Random(q0.size());
+        reference[i] = franka.frameVelocity(qs[i], dqs[i]);
+    }
+
+    std::vector<double> errors(num_threads, 0.0);
+    std::vector<std::thread> workers;
+    start = steady_clock::now();
+    for (size_t t = 0; t < num_threads; t++)
+        workers.emplace_back([&, t]() {
+            auto workspace = franka.workspace();
+            for (size_t i = 0; i < num_ticks; i++)
+                errors[t] = std::max(errors[t], (workspace.frameVelocity(qs[i], dqs[i]) - reference[i]).cwiseAbs().maxCoeff());
+        });
+    for (auto& worker : workers)
+        worker.join();
+    double shared_wall = duration<double>(steady_clock::now() - start).count();
+
+    // operational-space inertia along a smooth trajectory
+    auto inertia = [&](const double& tolerance, tools::Histogram& histogram) {
+        auto workspace = franka.workspace();
+        workspace.setInertiaTolerance(tolerance);
+        model::FrankaModel<>::Configuration qt = q0, velocity = model::FrankaModel<>::Configuration::Random();
+        for (size_t i = 0; i < num_ticks; i++) {
+            qt += 1e-3 * velocity;
+            auto tick = steady_clock::now();
+            workspace.update(qt, velocity);
+            workspace.taskInertia(qt);
+            histogram.record(duration_cast<nanoseconds>(steady_clock::now() - tick).count());
+        }
+        return double(workspace.factorizations()) / num_ticks;
+    };
+    tools::Histogram exact, reused;
+    double exact_factorizations = inertia(0.0, exact), reused_factorizations = inertia(1e-3, reused);
+
+    direct.print("direct", std::cout);
+    std::cout << "direct pinocchio calls/tick " << double(direct_calls) / num_ticks << " wall " << direct_wall << " [s]" << std::endl;
+    pinocchio.histogram.print("cached pinocchio", std::cout);
+    std::cout << "cached pinocchio passes/tick " << pinocchio.passes << " hits/tick " << pinocchio.hits << " wall " << pinocchio.wall << " [s]" << std::endl;
+    if (kernel) {
+        closed.histogram.print("cached kernel", std::cout);
+        std::cout << "cached kernel passes/tick " << closed.passes << " hits/tick " << closed.hits << " wall " << closed.wall << " [s]" << std::endl;
+    }
+    else
+        std::cout << "cached kernel: disabled by the description" << std::endl;
+    std::cout << "workspaces " << num_threads << " threads x " << num_ticks << " ticks wall " << shared_wall << " [s] max deviation "
+              << *std::max_element(errors.begin(), errors.end()) << std::endl;
+    exact.print("lambda exact", std::cout);
+    std::cout << "lambda exact factorizations/tick " << exact_factorizations << std::endl;
+    reused.print("lambda reused", std::cout);
+    std::cout << "lambda reused factorizations/tick " << reused_factorizations << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,378 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// QP benchmark on identical inputs: per-solve latency distribution, iterations, active bounds and unsolved count of the
+// ID and IK programs of sim_id / sim_ik, for several solver options (cold vs warm start, time budget, condensed IK),
+// against the generic control_lib QuadraticControl the controllers solved before (latency and largest deviation of each
+// option from its solutions). The condensed IK must match it on the joint velocities within TOLERANCE (relative,
+// |dq - dq_ref| / (1 + |dq_ref|)), otherwise the benchmark exits with 1. Inputs are either a synthetic 1 kHz rollout
+// of the ID solution towards a point 10 cm away from the start, or the QP inputs logged by the simulations:
+//
+//   ./build/src/bench/bench_qp [ticks]             synthetic rollout (5000 ticks) through both programs
+//   ./build/src/bench/bench_qp id qp_id.csv        log of `sim_id <demo> <transport> record`
+//   ./build/src/bench/bench_qp ik qp_ik.csv        log of `sim_ik <demo> <transport> <rate> record`
+//
+// Run from the repository root (the urdf path is relative).
+
+// Model
+#include "learn_embedding/model/FrankaModel.hpp"
+#include "learn_embedding/tools/Histogram.hpp"
+
+// Optimization
+#include "learn_embedding/optimization/InverseDynamics.hpp"
+#include "learn_embedding/optimization/InverseKinematics.hpp"
+
+// Generic QP
+#include <control_lib/controllers/QuadraticControl.hpp>
+#include <control_lib/spatial/R.hpp>
+
+// CPP Utils
+#include <utils_lib/FileManager.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+using namespace learn_embedding;
+using namespace std::chrono;
+
+using Workspace = model::FrankaWorkspace<7>;
+using Configuration = Workspace::Configuration;
+using R7 = control_lib::spatial::R<7>;
+
+// Largest relative deviation of the condensed IK joint velocities from the generic QP
+constexpr double TOLERANCE = 1e-3;
+
+// sim_id / sim_ik parameters of the generic QP (before src/learn_embedding/optimization)
+struct ParamsID {
+    struct controller : public control_lib::defaults::controller {
+        PARAM_SCALAR(double, dt, 1.0e-2);
+    };
+
+    struct quadratic_control : public control_lib::defaults::quadratic_control {
+        PARAM_SCALAR(size_t, nP, 7); // State dimension
+        PARAM_SCALAR(size_t, nC, 7); // Control/Input dimension (optimization torques)
+        PARAM_SCALAR(size_t, nS, 6); // Slack variable dimension
+        PARAM_SCALAR(size_t, oD, 2); // derivative order (optimization joint acceleration)
+    };
+};
+
+struct ParamsIK {
+    struct controller : public control_lib::defaults::controller {
+        PARAM_SCALAR(double, dt, 1.0e-2);
+    };
+
+    struct quadratic_control : public control_lib::defaults::quadratic_control {
+        PARAM_SCALAR(size_t, nP, 7); // State dimension
+        PARAM_SCALAR(size_t, nC, 0); // Control/Input dimension
+        PARAM_SCALAR(size_t, nS, 6); // Slack variable dimension
+        PARAM_SCALAR(size_t, oD, 1); // derivative order (optimization joint velocity)
+    };
+};
+
+// Inputs of one solve; log rows are (q, dq, task, state reference, input reference) for the ID, (q, task, state reference) for the IK
+struct Tick {
+    Configuration q, dq, state, input;
+    Eigen::Matrix<double, 6, 1> task;
+};
+
+// sim_id setup
+void inverseDynamics(optimization::InverseDynamics<7>& id, const std::shared_ptr<Workspace>& workspace, const Tick& tick)
+{
+    id.setModel(workspace)
+        .setTimeStep(1e-2)
+        .stateCost(Eigen::Matrix<double, 7, 7>::Identity())
+        .inputCost(0.1 * Eigen::Matrix<double, 7, 7>::Identity())
+        .inputReference(tick.input)
+        .stateReference(tick.state)
+        .slackCost(70.0 * Eigen::Matrix<double, 6, 6>::Identity())
+        .modelConstraint()
+        .inverseDynamics(tick.task)
+        .positionLimits()
+        .velocityLimits()
+        .accelerationLimits()
+        .effortLimits();
+}
+
+// sim_ik setup
+void inverseKinematics(optimization::InverseKinematics<7>& ik, const std::shared_ptr<Workspace>& workspace, const Tick& tick)
+{
+    ik.setModel(workspace)
+        .setTimeStep(1e-2)
+        .stateCost(Eigen::Matrix<double, 7, 7>::Identity())
+        .stateReference(tick.state)
+        .slackCost(10.0 * Eigen::Matrix<double, 6, 6>::Identity())
+        .inverseKinematics(tick.task)
+        .positionLimits()
+        .velocityLimits();
+}
+
+// Generic QP: it keeps references to its inputs, which are overwritten before each solve as the old controllers did
+template <typename Params>
+struct Generic {
+    Generic(const std::shared_ptr<model::FrankaModel<7>>& model) : model(model), state(7), input(7), task(6) {}
+
+    // Copy the references of the tick, returns its state
+    R7 inputs(const Tick& tick)
+    {
+        state = tick.state;
+        input = tick.input;
+        task = tick.task;
+        R7 curr(tick.q);
+        curr._v = tick.dq;
+        return curr;
+    }
+
+    const Eigen::VectorXd& operator()(const Tick& tick)
+    {
+        R7 curr = inputs(tick);
+        return output = qp(curr);
+    }
+
+    std::shared_ptr<model::FrankaModel<7>> model;
+    Eigen::VectorXd state, input, task, output;
+    control_lib::controllers::QuadraticControl<Params, model::FrankaModel<7>> qp;
+};
+
+void inverseDynamics(Generic<ParamsID>& id, const Tick& tick)
+{
+    id.qp.setModel(id.model)
+        .stateCost(Eigen::MatrixXd::Identity(7, 7))
+        .inputCost(0.1 * Eigen::MatrixXd::Identity(7, 7))
+        .inputReference(id.input)
+        .stateReference(id.state)
+        .slackCost(70.0 * Eigen::MatrixXd::Identity(6, 6))
+        .modelConstraint()
+        .inverseDynamics(id.task)
+        .positionLimits()
+        .velocityLimits()
+        .accelerationLimits()
+        .effortLimits()
+        .init(id.inputs(tick));
+}
+
+void inverseKinematics(Generic<ParamsIK>& ik, const Tick& tick)
+{
+    ik.qp.setModel(ik.model)
+        .stateCost(Eigen::MatrixXd::Identity(7, 7))
+        .stateReference(ik.state)
+        .slackCost(10.0 * Eigen::MatrixXd::Identity(6, 6))
+        .inverseKinematics(ik.task)
+        .positionLimits()
+        .velocityLimits()
+        .init(ik.inputs(tick));
+}
+
+// Per-tick inputs, as the controllers set them before each solve
+void inputs(optimization::InverseDynamics<7>& id, const Tick& tick)
+{
+    id.stateReference(tick.state).inputReference(tick.input).inverseDynamics(tick.task);
+}
+
+void inputs(optimization::InverseKinematics<7>& ik, const Tick& tick)
+{
+    ik.stateReference(tick.state).inverseKinematics(tick.task);
+}
+
+// Synthetic inputs: the ID drives the arm from the middle of its range towards a point 10 cm away
+std::vector<Tick> rollout(const std::shared_ptr<Workspace>& workspace, const size_t& num_ticks)
+{
+    const pinocchio::Model& pin = workspace->description()->model();
+    double dt = 1e-3;
+
+    std::vector<Tick> ticks;
+    ticks.reserve(num_ticks);
+
+    Tick tick;
+    Configuration middle = 0.5 * (pin.lowerPositionLimit + pin.upperPositionLimit);
+    tick.q = middle;
+    tick.dq.setZero();
+    Eigen::Vector3d target = workspace->framePose(tick.q).head<3>() + Eigen::Vector3d(0.1, 0.0, -0.1);
+
+    optimization::InverseDynamics<7> id;
+    inverseDynamics(id, workspace, tick);
+    for (size_t i = 0; i < num_ticks; i++) {
+        const Workspace::Pose& pose = workspace->framePose(tick.q);
+        const Workspace::Pose& velocity = workspace->frameVelocity(tick.q, tick.dq);
+        tick.task.head<3>() = 9.0 * (target - pose.head<3>()) - 6.0 * velocity.head<3>();
+        tick.task.tail<3>() = -velocity.tail<3>();
+        tick.state = (middle - tick.q) - 2.0 * tick.dq;
+        workspace->gravityVector(tick.q, tick.input);
+        ticks.push_back(tick);
+
+        inputs(id, tick);
+        Configuration ddq = id(tick.q, tick.dq).head<7>();
+        tick.q += dt * tick.dq + 0.5 * dt * dt * ddq;
+        tick.dq += dt * ddq;
+    }
+
+    return ticks;
+}
+
+// Solve every tick through the generic QP and report; returns the solutions column-wise
+template <typename Params>
+Eigen::MatrixXd replay(const std::string& name, Generic<Params>& generic, const std::vector<Tick>& ticks)
+{
+    tools::Histogram histogram;
+    Eigen::MatrixXd solutions;
+
+    for (size_t i = 0; i < ticks.size(); i++) {
+        auto start = steady_clock::now();
+        const Eigen::VectorXd& solution = generic(ticks[i]);
+        histogram.record(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+
+        if (!i)
+            solutions.resize(solution.size(), ticks.size());
+        solutions.col(i) = solution;
+    }
+
+    histogram.print(name, std::cout);
+
+    return solutions;
+}
+
+std::vector<Tick> load(const std::string& file, const bool& dynamics)
+{
+    utils_lib::FileManager reader;
+    Eigen::MatrixXd log = reader.setFile(file).read<Eigen::MatrixXd>();
+
+    std::vector<Tick> ticks;
+    if (log.cols() != (dynamics ? 34 : 20)) {
+        std::cerr << file << " has " << log.cols() << " columns, expected " << (dynamics ? 34 : 20) << std::endl;
+        return ticks;
+    }
+
+    ticks.resize(log.rows());
+    for (Eigen::Index i = 0; i < log.rows(); i++) {
+        Tick& tick = ticks[i];
+        tick.q = log.row(i).segment<7>(0);
+        if (dynamics) {
+            tick.dq = log.row(i).segment<7>(7);
+            tick.task = log.row(i).segment<6>(14);
+            tick.state = log.row(i).segment<7>(20);
+            tick.input = log.row(i).segment<7>(27);
+        }
+        else {
+            tick.dq.setZero();
+            tick.task = log.row(i).segment<6>(7);
+            tick.state = log.row(i).segment<7>(13);
+            tick.input.setZero();
+        }
+    }
+
+    return ticks;
+}
+
+// Solve every tick through one program and report; returns the solutions column-wise
+template <typename Controller>
+Eigen::MatrixXd replay(const std::string& name, Controller& program, const std::vector<Tick>& ticks, const Eigen::MatrixXd& reference = Eigen::MatrixXd())
+{
+    tools::Histogram histogram;
+    size_t iterations = 0, max_iterations = 0, active = 0, unsolved = 0;
+    Eigen::MatrixXd solutions(program.program().solution().size(), ticks.size());
+
+    for (size_t i = 0; i < ticks.size(); i++) {
+        const Tick& tick = ticks[i];
+        inputs(program, tick);
+        auto start = steady_clock::now();
+        if constexpr (std::is_same_v<Controller, optimization::InverseDynamics<7>>)
+            solutions.col(i) = program(tick.q, tick.dq);
+        else
+            solutions.col(i) = program(tick.q);
+        histogram.record(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+
+        iterations += program.iterations();
+        max_iterations = std::max(max_iterations, program.iterations());
+        active += program.active();
+        unsolved += program.status() != Controller::Program::SOLVED;
+    }
+
+    histogram.print(name, std::cout);
+    std::cout << name << " iterations mean " << double(iterations) / ticks.size() << " max " << max_iterations
+              << " active bounds mean " << double(active) / ticks.size() << " unsolved " << unsolved << " fallbacks " << program.fallbacks();
+    Eigen::Index rows = std::min(solutions.rows(), reference.rows());
+    if (reference.size())
+        std::cout << " max deviation " << (solutions.topRows(rows) - reference.topRows(rows)).cwiseAbs().maxCoeff();
+    std::cout << std::endl;
+
+    return solutions;
+}
+
+int main(int argc, char const* argv[])
+{
+    auto workspace = std::make_shared<model::FrankaModel<7>>();
+
+    std::string mode = (argc > 2) ? argv[1] : "both";
+    std::vector<Tick> ticks = (argc > 2) ? load(argv[2], mode == "id") : rollout(workspace, (argc > 1) ? std::stoul(argv[1]) : 5000);
+    if (ticks.empty())
+        return 1;
+    std::cout << ticks.size() << " ticks" << std::endl;
+
+    const Tick& tick = ticks.front();
+
+    if (mode != "ik") {
+        optimization::InverseDynamics<7> warm, cold, budget;
+        for (auto id : {&warm, &cold, &budget})
+            inverseDynamics(*id, workspace, tick);
+        cold.program().setWarmStart(false);
+        budget.setBudget(5.0e-5);
+
+        Generic<ParamsID> generic(workspace);
+        inverseDynamics(generic, tick);
+
+        Eigen::MatrixXd reference = replay("id QuadraticControl", generic, ticks);
+        replay("id warm", warm, ticks, reference);
+        replay("id cold", cold, ticks, reference);
+        replay("id warm 50us budget", budget, ticks, reference);
+    }
+
+    if (mode != "id") {
+        optimization::InverseKinematics<7> warm, cold, condensed, condensed_cold;
+        for (auto ik : {&warm, &cold, &condensed, &condensed_cold})
+            inverseKinematics(*ik, workspace, tick);
+        cold.program().setWarmStart(false);
+        condensed.setCondensed(true);
+        condensed_cold.setCondensed(true).box().setWarmStart(false);
+
+        Generic<ParamsIK> generic(workspace);
+        inverseKinematics(generic, tick);
+
+        Eigen::MatrixXd reference = replay("ik QuadraticControl", generic, ticks);
+        replay("ik warm", warm, ticks, reference);
+        replay("ik cold", cold, ticks, reference);
+        Eigen::MatrixXd solutions = replay("ik condensed", condensed, ticks, reference);
+        replay("ik condensed cold", condensed_cold, ticks, reference);
+
+        // joint velocities, the only part of the solution the IK controllers use
+        double deviation = ((solutions.topRows<7>() - reference.topRows<7>()).array().abs() / (1.0 + reference.topRows<7>().array().abs())).maxCoeff();
+        std::cout << "ik condensed max relative deviation " << deviation << " tolerance " << TOLERANCE << std::endl;
+        if (deviation > TOLERANCE) {
+            std::cerr << "ik condensed deviates from QuadraticControl" << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Round-trip latency of the ds link: zmq_stream request, zmq request with the fixed-layout Message
+// format (current TCP path) and shared memory ring. All servers are echo repliers running in a thread of this process, so only the transport is measured.
+
+// Stream
+#include <zmq.hpp>
+#include <zmq_stream/Requester.hpp>
+
+#include "learn_embedding/stream/SharedMemory.hpp"
+#include "learn_embedding/stream/WireRequester.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace learn_embedding;
+using namespace std::chrono;
+
+void report(const std::string& name, std::vector<double>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    double mean = 0.0;
+    for (auto& sample : samples)
+        mean += sample / samples.size();
+
+    std::cout << name
+              << " mean " << mean
+              << " p50 " << samples[samples.size() / 2]
+              << " p99 " << samples[size_t(0.99 * samples.size())]
+              << " max " << samples.back() << " [us]" << std::endl;
+}
+
+int main(int argc, char const* argv[])
+{
+    size_t num_requests = (argc > 1) ? std::stoul(argv[1]) : 10000;
+    std::atomic<bool> running(true);
+
+    Eigen::Matrix<double, 6, 1> x = Eigen::Matrix<double, 6, 1>::Random();
+    Eigen::Vector3d y;
+    std::vector<double> samples(num_requests);
+
+    // tcp
+    std::thread tcp_server([&]() {
+        zmq::context_t context(1);
+        zmq::socket_t socket(context, zmq::socket_type::rep);
+        socket.set(zmq::sockopt::rcvtimeo, 100);
+        socket.bind("tcp://*:5599");
+
+        while (running) {
+            zmq::message_t request;
+            if (!socket.recv(request, zmq::recv_flags::none))
+                continue;
+            socket.send(zmq::buffer(request.data(), 3 * sizeof(double)), zmq::send_flags::none);
+        }
+    });
+
+    zmq_stream::Requester requester;
+    requester.configure("localhost", "5599");
+
+    for (size_t i = 0; i < num_requests; i++) {
+        auto start = steady_clock::now();
+        y = requester.request<Eigen::VectorXd>(x, 3);
+        samples[i] = duration<double, std::micro>(steady_clock::now() - start).count();
+    }
+    report("zmq_stream tcp", samples);
+
+    // tcp, fixed-layout messages
+    std::thread wire_server([&]() {
+        zmq::context_t context(1);
+        zmq::socket_t socket(context, zmq::socket_type::rep);
+        socket.set(zmq::sockopt::rcvtimeo, 100);
+        socket.bind("tcp://*:5598");
+
+        stream::Message message;
+        while (running) {
+            if (!socket.recv(zmq::mutable_buffer(&message, sizeof(message)), zmq::recv_flags::none))
+                continue;
+            message.header.dim = 3;
+            socket.send(zmq::const_buffer(&message, message.size()), zmq::send_flags::none);
+        }
+    });
+
+    stream::WireRequester wire;
+    wire.configure("localhost", "5598");
+
+    for (size_t i = 0; i < num_requests; i++) {
+        auto start = steady_clock::now();
+        wire.request(x, y);
+        samples[i] = duration<double, std::micro>(steady_clock::now() - start).count();
+    }
+    report("zmq wire", samples);
+
+    // shared memory
+    std::thread shm_server([&]() {
+        stream::ShmReplier replier;
+        replier.configure("ds_bench");
+
+        tools::Spinner spinner;
+        while (running) {
+            if (replier.reply([](const auto& in, auto& out) { out = in.head(3); }, 3))
+                spinner.count = 0;
+            else
+                spinner.wait();
+        }
+    });
+
+    // let the server drain stale requests first
+    std::this_thread::sleep_for(milliseconds(100));
+
+    stream::ShmRequester shm;
+    shm.configure("ds_bench");
+
+    for (size_t i = 0; i < num_requests; i++) {
+        auto start = steady_clock::now();
+        shm.request(x, y);
+        samples[i] = duration<double, std::micro>(steady_clock::now() - start).count();
+    }
+    report("shm ring", samples);
+
+    running = false;
+    tcp_server.join();
+    wire_server.join();
+    shm_server.join();
+
+    return 0;
+}
@@ -22,6 +22,8 @@
     SOFTWARE.
 */
 
+#include <iostream>
+
 // Robot Handle
 #include <franka_control/Franka.hpp>
 
@@ -35,14 +37,22 @@
 
 // Controllers
 #include <control_lib/controllers/Feedback.hpp>
-#include <control_lib/controllers/QuadraticControl.hpp>
 
 // CPP Utils
 #include <utils_lib/FileManager.hpp>
 #include <utils_lib/Timer.hpp>
 
+// Model
+#include "learn_embedding/model/FrankaWorkspace.hpp"
+#include "learn_embedding/tools/Audit.hpp"
+#include "learn_embedding/tools/Logger.hpp"
+
+// Optimization
+#include "learn_embedding/optimization/InverseDynamics.hpp"
+
 // Stream
-#include <zmq_stream/Requester.hpp>
+#include "learn_embedding/dynamics/Parity.hpp"
+#include "learn_embedding/stream/DynamicsStream.hpp"
 
 // parse yaml
 #include <yaml-cpp/yaml.h>
@@ -51,7 +61,7 @@ using namespace franka_control;
 using namespace beautiful_bullet;
 using namespace control_lib;
 using namespace utils_lib;
-using namespace zmq_stream;
+using namespace learn_embedding;
 
 using R3 = spatial::R<3>;
 using R7 = spatial::R<7>;
@@ -66,13 +76,6 @@ struct ParamsConfig {
     struct feedback : public defaults::feedback {
         PARAM_SCALAR(size_t, d, 7);
     };
-
-    struct quadratic_control : public defaults::quadratic_control {
-        PARAM_SCALAR(size_t, nP, 7); // State dimension
-        PARAM_SCALAR(size_t, nC, 7); // Control/Input dimension (optimization torques)
-        PARAM_SCALAR(size_t, nS, 6); // Slack variable dimension (optimization slack)
-        PARAM_SCALAR(size_t, oD, 2); // derivative order (optimization joint acceleration)
-    };
 };
 
 struct ParamsTask {
@@ -85,33 +88,7 @@ struct ParamsTask {
     };
 };
 
-struct FrankaModel : public bodies::MultiBody {
-public:
-    FrankaModel() : bodies::MultiBody("rsc/franka/panda.urdf"), _frame("panda_joint_8"), _reference(pinocchio::LOCAL_WORLD_ALIGNED) {}
-
-    Eigen::MatrixXd jacobian(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobian(q, _frame, _reference);
-    }
-
-    Eigen::MatrixXd jacobianDerivative(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobianDerivative(q, dq, _frame, _reference);
-    }
-
-    Eigen::Matrix<double, 6, 1> framePose(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->framePose(q, _frame);
-    }
-
-    Eigen::Matrix<double, 6, 1> frameVelocity(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->frameVelocity(q, dq, _frame, _reference);
-    }
-
-    std::string _frame;
-    pinocchio::ReferenceFrame _reference;
-};
+using FrankaWorkspace = learn_embedding::model::FrankaWorkspace<7>;
 
 struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
     TaskDynamics()
@@ -131,7 +108,7 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
 
         // external ds stream
         _external = false;
-        _requester.configure("128.178.145.171", "5511");
+        _stream.configure("128.178.145.171", "5511");
     }
 
     TaskDynamics& setReference(const SE3& x)
@@ -155,6 +132,16 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
         return *this;
     }
 
+    TaskDynamics& setStream(const stream::Config& config)
+    {
+        _stream.configure(config);
+        return *this;
+    }
+
+    double replyAge() const { return _stream.age(); }
+
+    size_t replyMisses() const { return _stream.misses(); }
+
     void update(const SE3& x) override
     {
         // position ds
@@ -162,8 +149,8 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
         p._v = x._v.head(3);
         Eigen::Matrix<double, 6, 1> state;
         state << p._x, p._v;
-        if (_external)
-            _u.head(3) = _requester.request<Eigen::VectorXd>(state, 3);
+        if (_external && _stream.query(state, _reply))
+            _u.head(3) = _reply;
         else {
             _u.head(3) = _pos(p);
             if (_u.head(3).norm() >= 5.0)
@@ -190,16 +177,17 @@ protected:
     controllers::Feedback<ParamsTask, SO3> _rot;
 
     bool _external;
-    Requester _requester;
+    stream::DynamicsStream<6, 3> _stream;
+    Eigen::Vector3d _reply;
 };
 
 struct IDController : public franka_control::control::JointControl {
-    IDController(const franka::RobotState& state, const SE3& ref_pose)
-        : franka_control::control::JointControl(), _ref_pose(ref_pose), _model(std::make_shared<FrankaModel>())
+    IDController(const franka::RobotState& state, const SE3& ref_pose, const stream::Config& link = stream::Config())
+        : franka_control::control::JointControl(), _ref_pose(ref_pose), _model(std::make_shared<FrankaWorkspace>()), _audit("IDController::action")
     {
         // configuration ds
         R7 curr_state(jointPosition(state)),
-            ref_state((_model->positionUpper() + _model->positionLower()) * 0.5);
+            ref_state((_model->description()->model().upperPositionLimit + _model->description()->model().lowerPositionLimit) * 0.5);
         curr_state._v = jointVelocity(state);
         ref_state._v.setZero();
         double k = 1.0, d = 2.0 * std::sqrt(k);
@@ -210,13 +198,14 @@ struct IDController : public franka_control::control::JointControl {
             .update(curr_state);
 
         // input reference
-        _ref_input = _model->gravityVector(curr_state._x);
+        _model->gravityVector(curr_state._x, _ref_input);
 
         // task ds
         SE3 curr_pose(_model->framePose(curr_state._x));
         curr_pose._v = _model->jacobian(curr_state._x) * curr_state._v;
         _task
             .setReference(_ref_pose)
+            .setStream(link)
             .update(curr_pose);
 
         // inverse dynamics
@@ -226,6 +215,7 @@ struct IDController : public franka_control::control::JointControl {
         S.diagonal() << 5000.0, 5000.0, 5000.0, 10.0, 10.0, 10.0;
         _id
             .setModel(_model)
+            .setTimeStep(ParamsConfig::controller::dt())
             .stateCost(Q)
             .inputCost(R)
             .inputReference(_ref_input)
@@ -237,17 +227,28 @@ struct IDController : public franka_control::control::JointControl {
             .velocityLimits()
             .accelerationLimits()
             .effortLimits()
-            .init(curr_state);
+            // stay inside the 1 ms torque callback; unfinished solves fall back to gravity compensation
+            .setBudget(5.0e-4)
+            .setFallback(optimization::Fallback::SAFE)
+            .init(curr_state._x, curr_state._v);
 
         // writer
         _writer.setFile("exp_id_7.csv");
     }
 
+    ~IDController()
+    {
+        std::cout << "IDController::qp budget hits " << _id.program().budgetHits() << " fallbacks " << _id.fallbacks() << std::endl;
+    }
+
     Eigen::Matrix<double, 7, 1> action(const franka::RobotState& state) override
     {
+        tools::Audit::Scope audit(_audit);
+
         // curr
         R7 curr_state(jointPosition(state));
         curr_state._v = jointVelocity(state);
+        _model->update(curr_state._x, curr_state._v);
         SE3 curr_pose(_model->framePose(curr_state._x));
         curr_pose._v = _model->frameVelocity(curr_state._x, curr_state._v);
 
@@ -264,7 +265,7 @@ struct IDController : public franka_control::control::JointControl {
         _config.update(curr_state);
 
         // input reference
-        _ref_input = _model->gravityVector(curr_state._x);
+        _model->gravityVector(curr_state._x, _ref_input);
 
         // std::cout << "pinocchio" << std::endl;
         // std::cout << _model->jacobian(curr_state._x) << std::endl;
@@ -283,7 +284,11 @@ struct IDController : public franka_control::control::JointControl {
         // D *= 0.5;
 
         // ctr
-        return _id(curr_state).segment(7, 7) - _ref_input;
+        _id
+            .stateReference(_config.output())
+            .inputReference(_ref_input)
+            .inverseDynamics(_task.output());
+        return _id(curr_state._x, curr_state._v).segment(7, 7) - _ref_input;
     }
 
     // pose reference
@@ -295,11 +300,13 @@ struct IDController : public franka_control::control::JointControl {
     // configuration space ds
     controllers::Feedback<ParamsConfig, R7> _config;
     // inverse dynamics
-    controllers::QuadraticControl<ParamsConfig, FrankaModel> _id;
-    // model
-    std::shared_ptr<FrankaModel> _model;
-    // file manager
-    FileManager _writer;
+    optimization::InverseDynamics<7> _id;
+    // model (pinocchio only: the urdf is read from the model cache, no body is built)
+    std::shared_ptr<FrankaWorkspace> _model;
+    // allocations, locks and blocking io inside action
+    tools::Audit _audit;
+    // trajectory log, written by its own thread
+    tools::Logger<3> _writer;
 };
 
 int main(int argc, char const* argv[])
@@ -309,6 +316,19 @@ int main(int argc, char const* argv[])
     YAML::Node config = YAML::LoadFile("rsc/demos/" + demo + "/dynamics_params.yaml");
     auto offset = config["offset"].as<std::vector<double>>();
 
+    // ds transport (zmq, async, shm, native), the second argument overrides the demo configuration
+    stream::Config link("rsc/demos/" + demo, config["stream"], stream::Transport::ASYNC);
+    if (argc > 2)
+        link.setTransport(argv[2]);
+
+    // the native evaluator drives the robot only once it reproduces the python models (see tools/ds_parity)
+    if (link.transport == stream::Transport::NATIVE && !dynamics::parity<3>(link.demo))
+        return 1;
+
+    // a blocking request must never stall the 1 kHz torque callback
+    if (!(config["stream"] && config["stream"]["budget"]) && link.transport != stream::Transport::ASYNC)
+        link.budget = 5.0e-4;
+
     FileManager mng;
     std::vector<Eigen::MatrixXd> trajectories;
     for (size_t i = 1; i <= 7; i++) {
@@ -323,7 +343,7 @@ int main(int argc, char const* argv[])
     ref_pose._v.setZero();
 
     Franka robot("franka");
-    robot.setJointController(std::make_unique<IDController>(robot.state(), ref_pose));
+    robot.setJointController(std::make_unique<IDController>(robot.state(), ref_pose, link));
     robot.torque();
 
     return 0;
@@ -22,6 +22,7 @@
     SOFTWARE.
 */
 
+#include <atomic>
 #include <iostream>
 
 // Robot Handle
@@ -37,13 +38,22 @@
 
 // Task Space Dynamical System & Derivative Controller
 #include <control_lib/controllers/Feedback.hpp>
-#include <control_lib/controllers/QuadraticControl.hpp>
 
 // Reading/Writing Files
 #include <utils_lib/FileManager.hpp>
 
+// Model
+#include "learn_embedding/model/FrankaWorkspace.hpp"
+#include "learn_embedding/tools/Audit.hpp"
+#include "learn_embedding/tools/Logger.hpp"
+#include "learn_embedding/tools/MultiRate.hpp"
+
+// Optimization
+#include "learn_embedding/optimization/InverseKinematics.hpp"
+
 // Stream
-#include <zmq_stream/Requester.hpp>
+#include "learn_embedding/dynamics/Parity.hpp"
+#include "learn_embedding/stream/DynamicsStream.hpp"
 
 // parse yaml
 #include <yaml-cpp/yaml.h>
@@ -51,7 +61,7 @@
 using namespace franka_control;
 using namespace control_lib;
 using namespace beautiful_bullet;
-using namespace zmq_stream;
+using namespace learn_embedding;
 using namespace utils_lib;
 
 using R3 = spatial::R<3>;
@@ -67,13 +77,6 @@ struct ParamsConfig {
     struct feedback : public defaults::feedback {
         PARAM_SCALAR(size_t, d, 7); // Output dimension
     };
-
-    struct quadratic_control : public defaults::quadratic_control {
-        PARAM_SCALAR(size_t, nP, 7); // State dimension
-        PARAM_SCALAR(size_t, nC, 0); // Control/Input dimension
-        PARAM_SCALAR(size_t, nS, 6); // Slack variable dimension
-        PARAM_SCALAR(size_t, oD, 1); // derivative order (optimization joint velocity)
-    };
 };
 
 struct ParamsTask {
@@ -86,33 +89,8 @@ struct ParamsTask {
     };
 };
 
-struct FrankaModel : public bodies::MultiBody {
-public:
-    FrankaModel() : bodies::MultiBody("rsc/franka/panda.urdf"), _frame("panda_joint_8"), _reference(pinocchio::LOCAL_WORLD_ALIGNED) {}
-
-    Eigen::MatrixXd jacobian(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobian(q, _frame, _reference);
-    }
-
-    Eigen::MatrixXd jacobianDerivative(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobianDerivative(q, dq, _frame, _reference);
-    }
-
-    Eigen::Matrix<double, 6, 1> framePose(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->framePose(q, _frame);
-    }
-
-    Eigen::Matrix<double, 6, 1> frameVelocity(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->frameVelocity(q, dq, _frame, _reference);
-    }
-
-    std::string _frame;
-    pinocchio::ReferenceFrame _reference;
-};
+using FrankaWorkspace = learn_embedding::model::FrankaWorkspace<7>;
+using Planner = learn_embedding::tools::MultiRate<7>;
 
 struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
     TaskDynamics()
@@ -126,7 +104,7 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
 
         // external ds stream
         _external = false;
-        _requester.configure("128.178.145.171", "5511");
+        _stream.configure("128.178.145.171", "5511");
     }
 
     TaskDynamics& setReference(const SE3& x)
@@ -144,11 +122,24 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
         return *this;
     }
 
+    TaskDynamics& setStream(const stream::Config& config)
+    {
+        _stream.configure(config);
+        return *this;
+    }
+
+    double replyAge() const { return _stream.age(); }
+
+    size_t replyMisses() const { return _stream.misses(); }
+
     void update(const SE3& x) override
     {
         // if (_external)
         //     std::cout << _requester.request<Eigen::VectorXd>(x._trans, 3).transpose() << std::endl;
-        _u.head(3) = _external ? _requester.request<Eigen::VectorXd>(x._trans, 3) : _pos(R3(x._trans));
+        if (_external && _stream.query(x._trans, _reply))
+            _u.head(3) = _reply;
+        else
+            _u.head(3) = _pos(R3(x._trans));
         // _u.head(3) = _pos(R3(x._trans));
         if (_u.head(3).norm() >= 0.3)
             _u.head(3) /= _u.head(3).norm() / 0.3;
@@ -168,17 +159,26 @@ protected:
     controllers::Feedback<ParamsTask, SO3> _rot;
 
     bool _external;
-    Requester _requester;
+    stream::DynamicsStream<3, 3> _stream;
+    Eigen::Vector3d _reply;
 };
 
 class IKController : public franka_control::control::JointControl {
 public:
-    IKController(const franka::RobotState& state, const SE3& ref_pose)
-        : franka_control::control::JointControl(), _ref_pose(ref_pose), _model(std::make_shared<FrankaModel>())
+    // rate of the IK [Hz], 0 solves it inside every control tick
+    IKController(const franka::RobotState& state, const SE3& ref_pose, const stream::Config& link = stream::Config(), const double& rate = 0.0)
+        : franka_control::control::JointControl(), _ref_pose(ref_pose), _model(std::make_shared<FrankaWorkspace>()), _audit("IKController::action"),
+          _external(false), _multirate(rate > 0.0), _time(0.0)
     {
+        // the IK thread evaluates the model on its own workspace
+        if (_multirate)
+            _planning = std::make_shared<FrankaWorkspace>(_model->description());
+        else
+            _planning = _model;
+
         // config ds
         R7 curr_state(jointPosition(state)),
-            ref_state((_model->positionUpper() + _model->positionLower()) * 0.5);
+            ref_state((_model->description()->model().upperPositionLimit + _model->description()->model().lowerPositionLimit) * 0.5);
         _config
             .setStiffness(1.0 * Eigen::MatrixXd::Identity(7, 7))
             .setReference(ref_state)
@@ -187,6 +187,7 @@ public:
         // task ds
         SE3 curr_pose(_model->framePose(curr_state._x));
         _task.setReference(_ref_pose)
+            .setStream(link)
             .update(curr_pose);
 
         // ik
@@ -194,14 +195,20 @@ public:
         Q.diagonal() << 10.0, 10.0, 10.0, 10.0, 10.0, 10.0, 10.0;
         S.diagonal() << 1000.0, 1000.0, 1000.0, 10.0, 10.0, 10.0;
         _ik
-            .setModel(_model)
+            .setModel(_planning)
+            // position limits over the time a solution is followed: one control step inline, one IK period in multi-rate mode
+            .setTimeStep(_multirate ? 1.0 / rate : ParamsConfig::controller::dt())
             .stateCost(Q)
             .stateReference(_config.output())
             .slackCost(S)
             .inverseKinematics(_task.output())
             .positionLimits()
             .velocityLimits()
-            .init(curr_state);
+            .setCondensed(true)
+            // if solved by ADMM, stay inside the 1 ms torque callback (or the IK period); unfinished solves hold the configuration
+            .setBudget(_multirate ? 0.5 / rate : 3.0e-4)
+            .setFallback(optimization::Fallback::SAFE)
+            .init(curr_state._x);
 
         // ctr
         Eigen::MatrixXd K = Eigen::MatrixXd::Zero(7, 7), D = Eigen::MatrixXd::Zero(7, 7);
@@ -218,52 +225,92 @@ public:
 
         _open = false;
         _ik_state = curr_state;
+
+        // from here on config ds, task ds and ik belong to the IK thread (closed loop only); waypoints lead their state by
+        // one controller step (see MultiRate)
+        if (_multirate)
+            _planner
+                .setPeriod(1.0 / rate)
+                .start(curr_state._x, _time, [this](const Planner::State& state, Planner::Reference& reference) {
+                    reference.dq = plan(state.q);
+                    reference.q = state.q + ParamsConfig::controller::dt() * reference.dq;
+                });
+    }
+
+    ~IKController()
+    {
+        // the IK thread writes the qp counters, stop it first
+        if (_multirate)
+            _planner.stop();
+
+        std::cout << "IKController::qp budget hits " << _ik.program().budgetHits() << " fallbacks " << _ik.fallbacks() << std::endl;
+        if (_multirate) {
+            _planner.latency().print("IKController::plan", std::cout);
+            std::cout << "IKController::plan overruns " << _planner.overruns() << " stalls " << _planner.stalls() << std::endl;
+        }
     }
 
     Eigen::Matrix<double, 7, 1> action(const franka::RobotState& state) override
     {
+        tools::Audit::Scope audit(_audit);
+
         // curr
         R7 curr_state(jointPosition(state));
         curr_state._v = jointVelocity(state);
+        _model->update(curr_state._x, curr_state._v);
         SE3 curr_pose(_model->framePose(_open ? _ik_state._x : curr_state._x));
 
-        // if (_task.external())
-        //     _writer.append(curr_pose._trans.transpose());
-
-        // config ds
-        _config.update(_open ? _ik_state : curr_state);
+        if (_external)
+            _writer.append(curr_pose._trans.transpose());
 
         // task ds
         // std::cout << (curr_pose._trans - _ref_pose._trans).norm() << std::endl;
-        if ((curr_pose._trans - _ref_pose._trans).norm() <= 0.03 && !_task.external())
-            _task.setExternal(true);
-        _task.update(curr_pose);
+        if ((curr_pose._trans - _ref_pose._trans).norm() <= 0.03 && !_external)
+            _external = true;
 
         // ik
-        auto state_vel = _ik(curr_state).segment(0, 7);
-        // R7 ref_state(curr_state._x + ParamsConfig::controller::dt() * state_vel);
         R7 ref_state;
-        if (_open) {
-            ref_state._x = _ik_state._x + ParamsConfig::controller::dt() * _ik(_ik_state).segment(0, 7);
-            _ik_state = ref_state;
+        if (_multirate) {
+            // joint impedance along the latest IK waypoint
+            _time += ParamsConfig::controller::dt();
+            _planner.update(curr_state._x, curr_state._v, _time);
+            ref_state._x = _planner.position();
+            ref_state._v = _planner.velocity();
+        }
+        else {
+            if (_open) {
+                ref_state._x = _ik_state._x + ParamsConfig::controller::dt() * plan(_ik_state._x);
+                _ik_state = ref_state;
+            }
+            else
+                ref_state._x = curr_state._x + ParamsConfig::controller::dt() * plan(curr_state._x);
+            ref_state._v.setZero();
         }
-        else
-            ref_state._x = curr_state._x + ParamsConfig::controller::dt() * _ik(curr_state).segment(0, 7);
-        ref_state._v.setZero();
         // std::cout << state_vel.transpose() << std::endl;
 
-        auto tau = _ctr.setReference(ref_state).action(curr_state);
+        return _ctr.setReference(ref_state).action(curr_state);
+    }
 
-        std::cout << "tau" << std::endl;
-        std::cout << tau.transpose() << std::endl;
-        std::cout << "ref" << std::endl;
-        std::cout << ref_state._x.transpose() << std::endl;
-        std::cout << "-" << std::endl;
+protected:
+    // Config ds, task ds and IK at q: joint velocity
+    Eigen::Matrix<double, 7, 1> plan(const Eigen::Matrix<double, 7, 1>& q)
+    {
+        R7 state(q);
 
-        return tau;
+        // config ds
+        _config.update(state);
+
+        // task ds
+        if (_external && !_task.external())
+            _task.setExternal(true);
+        _task.update(SE3(_planning->framePose(q)));
+
+        _ik
+            .stateReference(_config.output())
+            .inverseKinematics(_task.output());
+        return _ik(q).segment(0, 7);
     }
 
-protected:
     // reference
     SE3 _ref_pose;
     // task space ds
@@ -271,17 +318,28 @@ protected:
     // configuration space ds
     controllers::Feedback<ParamsConfig, R7> _config;
     // inverse kinematics
-    controllers::QuadraticControl<ParamsConfig, FrankaModel> _ik;
+    optimization::InverseKinematics<7> _ik;
     // task space controller
     controllers::Feedback<ParamsConfig, R7> _ctr;
-    // model
-    std::shared_ptr<FrankaModel> _model;
-    // file manager
-    FileManager _writer;
+    // model (pinocchio only: the urdf is read from the model cache, no body is built)
+    std::shared_ptr<FrankaWorkspace> _model;
+    // allocations, locks and blocking io inside action
+    tools::Audit _audit;
+    // trajectory log, written by its own thread
+    tools::Logger<3> _writer;
 
     // prev state
     bool _open;
     R7 _ik_state;
+
+    // model of config ds, task ds and ik (a separate workspace when they run on the IK thread)
+    std::shared_ptr<FrankaWorkspace> _planning;
+    // external ds switch, set by action and applied by the IK
+    std::atomic<bool> _external;
+    // IK thread and control time [s]
+    bool _multirate;
+    double _time;
+    Planner _planner;
 };
 
 int main(int argc, char const* argv[])
@@ -291,6 +349,22 @@ int main(int argc, char const* argv[])
     YAML::Node config = YAML::LoadFile("rsc/demos/" + demo + "/dynamics_params.yaml");
     auto offset = config["offset"].as<std::vector<double>>();
 
+    // ds transport (zmq, async, shm, native), the second argument overrides the demo configuration
+    stream::Config link("rsc/demos/" + demo, config["stream"]);
+    if (argc > 2)
+        link.setTransport(argv[2]);
+
+    // the native evaluator drives the robot only once it reproduces the python models (see tools/ds_parity)
+    if (link.transport == stream::Transport::NATIVE && !dynamics::parity<3>(link.demo))
+        return 1;
+
+    // IK rate [Hz] on its own thread, 0 (default) solves it inside the 1 kHz torque callback
+    double rate = (argc > 3) ? std::stod(argv[3]) : 0.0;
+
+    // a blocking request must never stall the 1 kHz torque callback
+    if (!(config["stream"] && config["stream"]["budget"]) && link.transport != stream::Transport::ASYNC)
+        link.budget = 5.0e-4;
+
     FileManager mng;
     std::vector<Eigen::MatrixXd> trajectories;
     for (size_t i = 1; i <= 7; i++) {
@@ -304,7 +378,7 @@ int main(int argc, char const* argv[])
     SE3 ref_pose(ref_rot, ref_pos);
 
     Franka robot("franka");
-    robot.setJointController(std::make_unique<IKController>(robot.state(), ref_pose));
+    robot.setJointController(std::make_unique<IKController>(robot.state(), ref_pose, link, rate));
     robot.torque();
 
     return 0;
@@ -17,8 +17,14 @@
 // Reading/Writing Files
 #include <utils_lib/FileManager.hpp>
 
+// Model
+#include "learn_embedding/model/FrankaWorkspace.hpp"
+#include "learn_embedding/tools/Audit.hpp"
+#include "learn_embedding/tools/Logger.hpp"
+
 // Stream
-#include <zmq_stream/Requester.hpp>
+#include "learn_embedding/dynamics/Parity.hpp"
+#include "learn_embedding/stream/DynamicsStream.hpp"
 
 // parse yaml
 #include <yaml-cpp/yaml.h>
@@ -26,7 +32,7 @@
 using namespace franka_control;
 using namespace control_lib;
 using namespace beautiful_bullet;
-using namespace zmq_stream;
+using namespace learn_embedding;
 using namespace utils_lib;
 
 using R3 = spatial::R<3>;
@@ -57,33 +63,7 @@ struct ParamsCTR {
     };
 };
 
-struct FrankaModel : public bodies::MultiBody {
-public:
-    FrankaModel() : bodies::MultiBody("rsc/franka/panda.urdf"), _frame("panda_joint_8"), _reference(pinocchio::LOCAL_WORLD_ALIGNED) {}
-
-    Eigen::MatrixXd jacobian(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobian(q, _frame, _reference);
-    }
-
-    Eigen::MatrixXd jacobianDerivative(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobianDerivative(q, dq, _frame, _reference);
-    }
-
-    Eigen::Matrix<double, 6, 1> framePose(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->framePose(q, _frame);
-    }
-
-    Eigen::Matrix<double, 6, 1> frameVelocity(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->frameVelocity(q, dq, _frame, _reference);
-    }
-
-    std::string _frame;
-    pinocchio::ReferenceFrame _reference;
-};
+using FrankaWorkspace = learn_embedding::model::FrankaWorkspace<7>;
 
 struct TaskDynamics : public controllers::AbstractController<ParamsDS, SE3> {
     TaskDynamics()
@@ -97,7 +77,7 @@ struct TaskDynamics : public controllers::AbstractController<ParamsDS, SE3> {
 
         // external ds stream
         _external = false;
-        _requester.configure("128.178.145.171", "5511");
+        _stream.configure("128.178.145.171", "5511");
     }
 
     TaskDynamics& setReference(const SE3& x)
@@ -115,12 +95,25 @@ struct TaskDynamics : public controllers::AbstractController<ParamsDS, SE3> {
         return *this;
     }
 
+    TaskDynamics& setStream(const stream::Config& config)
+    {
+        _stream.configure(config);
+        return *this;
+    }
+
+    double replyAge() const { return _stream.age(); }
+
+    size_t replyMisses() const { return _stream.misses(); }
+
     void update(const SE3& x) override
     {
         // position ds
         // if (_external)
         //     std::cout << _requester.request<Eigen::VectorXd>(x._trans, 3).transpose() << std::endl;
-        _u.head(3) = _external ? _requester.request<Eigen::VectorXd>(x._trans, 3) : _pos(R3(x._trans));
+        if (_external && _stream.query(x._trans, _reply))
+            _u.head(3) = _reply;
+        else
+            _u.head(3) = _pos(R3(x._trans));
         // _u.head(3) = _pos(R3(x._trans));
         if (_u.head(3).norm() >= 0.3)
             _u.head(3) /= _u.head(3).norm() / 0.3;
@@ -141,16 +134,19 @@ protected:
     controllers::Feedback<ParamsDS, SO3> _rot;
 
     bool _external;
-    Requester _requester;
+    stream::DynamicsStream<3, 3> _stream;
+    Eigen::Vector3d _reply;
 };
 
 class OperationSpaceController : public franka_control::control::JointControl {
 public:
-    OperationSpaceController(const SE3& ref_pose)
-        : franka_control::control::JointControl(), _ref_pose(ref_pose), _model(std::make_shared<FrankaModel>())
+    OperationSpaceController(const SE3& ref_pose, const stream::Config& link = stream::Config())
+        : franka_control::control::JointControl(), _ref_pose(ref_pose), _consistent(false), _audit("OperationSpaceController::action")
     {
         // ds
-        _ds.setReference(_ref_pose);
+        _ds
+            .setReference(_ref_pose)
+            .setStream(link);
 
         // ctr
         Eigen::Matrix<double, 6, 6> damping = Eigen::Matrix<double, 6, 6>::Zero();
@@ -161,24 +157,37 @@ public:
         _writer.setFile("exp_os_7.csv");
     }
 
+    // Dynamically consistent law tau = J^T Lambda F instead of tau = J^T F; M is refreshed every "tolerance" rad of motion
+    OperationSpaceController& setConsistent(const bool& consistent, const double& tolerance = 1e-3)
+    {
+        _consistent = consistent;
+        _model.setInertiaTolerance(tolerance);
+        return *this;
+    }
+
     Eigen::Matrix<double, 7, 1> action(const franka::RobotState& state) override
     {
+        tools::Audit::Scope audit(_audit);
+
         // state
         Eigen::Matrix<double, 7, 1> q = jointPosition(state), dq = jointVelocity(state);
-        SE3 curr_pose(_model->framePose(q));
+        _model.update(q, dq);
+        SE3 curr_pose(_model.framePose(q));
 
-        // if (_ds.external())
-        //     _writer.append(curr_pose._trans.transpose());
+        if (_ds.external())
+            _writer.append(curr_pose._trans.transpose());
 
-        std::cout << (curr_pose._trans - _ref_pose._trans).norm() << std::endl;
         if ((curr_pose._trans - _ref_pose._trans).norm() <= 0.03 && !_ds.external())
             _ds.setExternal(true);
-        Eigen::Matrix<double, 6, 7> jac = _model->jacobian(q);
-        curr_pose._v = jac * dq;
+        _model.jacobian(q, _jacobian);
+        curr_pose._v = _jacobian * dq;
         _ref_pose._v = _ds(curr_pose);
         _ctr.setReference(_ref_pose);
+        _wrench = _ctr(curr_pose);
+        if (_consistent)
+            _wrench = _model.taskInertia(q) * _wrench;
 
-        return jac.transpose() * _ctr(curr_pose);
+        return _jacobian.transpose() * _wrench;
     }
 
 protected:
@@ -188,10 +197,15 @@ protected:
     TaskDynamics _ds;
     // task space controller
     controllers::Feedback<ParamsCTR, SE3> _ctr;
-    // model
-    std::shared_ptr<FrankaModel> _model;
-    // file manager
-    FileManager _writer;
+    // model (no simulated body on the robot, the kinematics workspace is enough)
+    FrankaWorkspace _model;
+    FrankaWorkspace::Jacobian _jacobian;
+    Eigen::Matrix<double, 6, 1> _wrench;
+    bool _consistent;
+    // allocations, locks and blocking io inside action
+    tools::Audit _audit;
+    // trajectory log, written by its own thread
+    tools::Logger<3> _writer;
 };
 
 int main(int argc, char const* argv[])
@@ -201,6 +215,22 @@ int main(int argc, char const* argv[])
     YAML::Node config = YAML::LoadFile("rsc/demos/" + demo + "/dynamics_params.yaml");
     auto offset = config["offset"].as<std::vector<double>>();
 
+    // ds transport (zmq, async, shm, native), the second argument overrides the demo configuration
+    stream::Config link("rsc/demos/" + demo, config["stream"], stream::Transport::ASYNC);
+    if (argc > 2)
+        link.setTransport(argv[2]);
+
+    // the native evaluator drives the robot only once it reproduces the python models (see tools/ds_parity)
+    if (link.transport == stream::Transport::NATIVE && !dynamics::parity<3>(link.demo))
+        return 1;
+
+    // "consistent" as third argument weights the task law with the operational-space inertia
+    bool consistent = argc > 3 && std::string(argv[3]) == "consistent";
+
+    // a blocking request must never stall the 1 kHz torque callback
+    if (!(config["stream"] && config["stream"]["budget"]) && link.transport != stream::Transport::ASYNC)
+        link.budget = 5.0e-4;
+
     FileManager mng;
     std::vector<Eigen::MatrixXd> trajectories;
     for (size_t i = 1; i <= 7; i++) {
@@ -214,7 +244,9 @@ int main(int argc, char const* argv[])
     SE3 ref_pose(ref_rot, ref_pos);
 
     Franka robot("franka");
-    robot.setJointController(std::make_unique<OperationSpaceController>(ref_pose));
+    auto controller = std::make_unique<OperationSpaceController>(ref_pose, link);
+    controller->setConsistent(consistent);
+    robot.setJointController(std::move(controller));
     robot.torque();
 
     return 0;
@@ -0,0 +1,201 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_APPROXIMATORS_FEEDFORWARD_HPP
+#define LEARNEMBEDDING_APPROXIMATORS_FEEDFORWARD_HPP
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/tools/TorchArchive.hpp"
+
+namespace learn_embedding {
+    namespace approximators {
+        /*
+            Scalar tanh network, counterpart of learn_embedding.approximators.FeedForward.
+
+            Besides the output it propagates, in forward mode, the first and second
+            derivatives w.r.t. the input, which are needed by the embedding metric and
+            its Christoffel symbols. All buffers are sized once in load().
+            Gradients of a whole batch are computed in reverse mode with matrix products;
+            the batch buffers only grow with the batch size.
+        */
+        class FeedForward {
+        public:
+            FeedForward() : _dim(0) {}
+
+            // Read weights and biases starting from storage k; returns the next storage index
+            size_t load(const tools::TorchArchive& archive, size_t k, const size_t& dim, const size_t& neurons, const size_t& layers)
+            {
+                _dim = dim;
+                _weights.resize(layers + 1);
+                _biases.resize(layers + 1);
+
+                for (size_t i = 0; i <= layers; i++) {
+                    size_t rows = (i == layers) ? 1 : neurons, cols = i ? neurons : dim;
+                    if (!archive.tensor(k++, rows, cols, _weights[i]) || !archive.tensor(k++, rows, _biases[i]))
+                        return 0;
+                }
+
+                _z.setZero(neurons);
+                _a.setZero(neurons);
+                _da.setZero(neurons, dim);
+                _dz.setZero(neurons, dim);
+                _dda.setZero(neurons, dim * dim);
+                _ddz.setZero(neurons, dim * dim);
+                _d1.setZero(neurons);
+                _d2.setZero(neurons);
+                _h.setZero(dim * dim);
+
+                return k;
+            }
+
+            const size_t& dimension() const { return _dim; }
+
+            // Network output
+            double operator()(const Eigen::Ref<const Eigen::VectorXd>& x)
+            {
+                for (size_t i = 0; i < _weights.size() - 1; i++) {
+                    if (i)
+                        _z.noalias() = _weights[i] * _a;
+                    else
+                        _z.noalias() = _weights[i] * x;
+                    _a = (_z + _biases[i]).array().tanh();
+                }
+
+                return _weights.back().row(0).dot(_a) + _biases.back()(0);
+            }
+
+            // Output and gradient
+            double operator()(const Eigen::Ref<const Eigen::VectorXd>& x, Eigen::Ref<Eigen::VectorXd> grad)
+            {
+                for (size_t i = 0; i < _weights.size() - 1; i++) {
+                    if (i) {
+                        _z.noalias() = _weights[i] * _a;
+                        _dz.noalias() = _weights[i] * _da;
+                    }
+                    else {
+                        _z.noalias() = _weights[i] * x;
+                        _dz = _weights[i];
+                    }
+                    _z += _biases[i];
+
+                    _a = _z.array().tanh();
+                    _d1 = 1.0 - _a.array().square();
+                    _da.noalias() = _d1.matrix().asDiagonal() * _dz;
+                }
+
+                const auto w = _weights.back().row(0);
+                grad.noalias() = _da.transpose() * w.transpose();
+
+                return w.dot(_a) + _biases.back()(0);
+            }
+
+            // Output, gradient and Hessian
+            double operator()(const Eigen::Ref<const Eigen::VectorXd>& x, Eigen::Ref<Eigen::VectorXd> grad, Eigen::Ref<Eigen::MatrixXd> hess)
+            {
+                size_t n = _dim;
+
+                for (size_t i = 0; i < _weights.size() - 1; i++) {
+                    const Eigen::MatrixXd& W = _weights[i];
+
+                    if (i) {
+                        _z.noalias() = W * _a;
+                        _dz.noalias() = W * _da;
+                        _ddz.noalias() = W * _dda;
+                    }
+                    else {
+                        _z.noalias() = W * x;
+                        _dz = W;
+                        _ddz.setZero();
+                    }
+                    _z += _biases[i];
+
+                    // tanh' = 1 - tanh^2, tanh'' = -2 tanh (1 - tanh^2)
+                    _a = _z.array().tanh();
+                    _d1 = 1.0 - _a.array().square();
+                    _d2 = -2.0 * _a.array() * _d1;
+
+                    for (size_t r = 0; r < n; r++)
+                        for (size_t c = 0; c < n; c++)
+                            _dda.col(r * n + c) = _d1 * _ddz.col(r * n + c).array() + _d2 * _dz.col(r).array() * _dz.col(c).array();
+
+                    _da.noalias() = _d1.matrix().asDiagonal() * _dz;
+                }
+
+                const auto w = _weights.back().row(0);
+                grad.noalias() = _da.transpose() * w.transpose();
+                _h.noalias() = w * _dda;
+                hess = Eigen::Map<const Eigen::MatrixXd>(_h.data(), n, n);
+
+                return w.dot(_a) + _biases.back()(0);
+            }
+
+            // Gradients of a batch of inputs, one per column
+            void gradient(const Eigen::Ref<const Eigen::MatrixXd>& X, Eigen::Ref<Eigen::MatrixXd> G)
+            {
+                size_t layers = _weights.size() - 1;
+                _derivatives.resize(layers);
+
+                // forward pass, keeping tanh' of every layer
+                for (size_t i = 0; i < layers; i++) {
+                    if (i)
+                        _products.noalias() = _weights[i] * _activations;
+                    else
+                        _products.noalias() = _weights[i] * X;
+                    _products.colwise() += _biases[i];
+                    _activations = _products.array().tanh();
+                    _derivatives[i] = 1.0 - _activations.array().square();
+                }
+
+                // backward pass
+                _adjoints = _derivatives.back().array().colwise() * _weights.back().row(0).transpose().array();
+                for (size_t i = layers - 1; i > 0; i--) {
+                    _products.noalias() = _weights[i].transpose() * _adjoints;
+                    _adjoints = _derivatives[i - 1].array() * _products.array();
+                }
+                G.noalias() = _weights[0].transpose() * _adjoints;
+            }
+
+        protected:
+            size_t _dim;
+
+            std::vector<Eigen::MatrixXd> _weights;
+            std::vector<Eigen::VectorXd> _biases;
+
+            // forward mode buffers
+            Eigen::VectorXd _z, _a;
+            Eigen::MatrixXd _dz, _da, _ddz, _dda;
+            Eigen::ArrayXd _d1, _d2;
+            Eigen::RowVectorXd _h;
+
+            // batch buffers
+            Eigen::MatrixXd _products, _activations, _adjoints;
+            std::vector<Eigen::MatrixXd> _derivatives;
+        };
+    } // namespace approximators
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_APPROXIMATORS_FEEDFORWARD_HPP
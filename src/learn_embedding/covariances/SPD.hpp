@@ -0,0 +1,74 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_COVARIANCES_SPD_HPP
+#define LEARNEMBEDDING_COVARIANCES_SPD_HPP
+
+#include <Eigen/Core>
+#include <unsupported/Eigen/MatrixFunctions>
+
+#include "learn_embedding/tools/TorchArchive.hpp"
+
+namespace learn_embedding {
+    namespace covariances {
+        /*
+            Symmetric positive definite matrix, counterpart of learn_embedding.covariances.SPD.
+
+            Parametrized by log-eigenvalues (eigval_) and by the upper triangular entries of
+            a skew-symmetric matrix (eigvec_) whose exponential gives the eigenvectors.
+            The matrix is assembled once at load time.
+        */
+        class SPD {
+        public:
+            SPD() = default;
+
+            // Read eigval_ and eigvec_ starting from storage k; returns the next storage index
+            size_t load(const tools::TorchArchive& archive, size_t k, const size_t& dim)
+            {
+                Eigen::VectorXd eigval, eigvec;
+                if (!archive.tensor(k++, dim, eigval) || !archive.tensor(k++, dim * (dim - 1) / 2, eigvec))
+                    return 0;
+
+                Eigen::MatrixXd skew = Eigen::MatrixXd::Zero(dim, dim);
+                for (size_t i = 0, l = 0; i < dim; i++)
+                    for (size_t j = i + 1; j < dim; j++, l++) {
+                        skew(i, j) = eigvec(l);
+                        skew(j, i) = -eigvec(l);
+                    }
+
+                Eigen::MatrixXd V = skew.exp();
+                _matrix = V * eigval.array().exp().matrix().asDiagonal() * V.transpose();
+
+                return k;
+            }
+
+            const Eigen::MatrixXd& matrix() const { return _matrix; }
+
+        protected:
+            Eigen::MatrixXd _matrix;
+        };
+    } // namespace covariances
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_COVARIANCES_SPD_HPP
@@ -0,0 +1,69 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_DYNAMICS_ABSTRACTDYNAMICS_HPP
+#define LEARNEMBEDDING_DYNAMICS_ABSTRACTDYNAMICS_HPP
+
+#include <Eigen/Core>
+
+namespace learn_embedding {
+    namespace dynamics {
+        // In-process replacement for the external ds: state of size In to output of size Out
+        template <int In, int Out>
+        class AbstractDynamics {
+        public:
+            using Input = Eigen::Matrix<double, In, 1>;
+            using Output = Eigen::Matrix<double, Out, 1>;
+            using Inputs = Eigen::Matrix<double, In, Eigen::Dynamic>;
+            using Outputs = Eigen::Matrix<double, Out, Eigen::Dynamic>;
+
+            virtual ~AbstractDynamics() = default;
+
+            virtual void evaluate(const Input& x, Output& y) = 0;
+
+            // Batch of states, one per column; models can override it with a vectorized pass
+            virtual void batch(const Inputs& X, Outputs& Y)
+            {
+                Output y;
+                Y.resize(Out, X.cols());
+                for (Eigen::Index i = 0; i < X.cols(); i++) {
+                    evaluate(X.col(i), y);
+                    Y.col(i) = y;
+                }
+            }
+
+            // Whether x lies in the region where the model can be trusted
+            virtual bool contains(const Input& /*x*/) const { return true; }
+
+            Output operator()(const Input& x)
+            {
+                Output y;
+                evaluate(x, y);
+                return y;
+            }
+        };
+    } // namespace dynamics
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_DYNAMICS_ABSTRACTDYNAMICS_HPP
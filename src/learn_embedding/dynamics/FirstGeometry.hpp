@@ -0,0 +1,130 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_DYNAMICS_FIRSTGEOMETRY_HPP
+#define LEARNEMBEDDING_DYNAMICS_FIRSTGEOMETRY_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "learn_embedding/covariances/SPD.hpp"
+#include "learn_embedding/dynamics/AbstractDynamics.hpp"
+#include "learn_embedding/embedding/Embedding.hpp"
+
+namespace learn_embedding {
+    namespace dynamics {
+        /*
+            First order ds dx = -g^-1(x) K (x - a), counterpart of learn_embedding.dynamics.FirstGeometry.
+            The attractor a is the demo offset, which the python server subtracts before inference.
+        */
+        template <int D>
+        class FirstGeometry : public AbstractDynamics<D, D> {
+        public:
+            using Vector = Eigen::Matrix<double, D, 1>;
+            using Matrix = Eigen::Matrix<double, D, D>;
+            using typename AbstractDynamics<D, D>::Inputs;
+            using typename AbstractDynamics<D, D>::Outputs;
+
+            FirstGeometry() : _attractor(Vector::Zero()), _stiffness(Matrix::Identity()) {}
+
+            // Load "first_order" model of a demo folder (e.g. rsc/demos/demo_2)
+            bool load(const std::string& demo)
+            {
+                YAML::Node params = YAML::LoadFile(demo + "/dynamics_params.yaml");
+                if (params["dimension"].as<int>() != D) {
+                    std::cerr << "Model dimension does not match " << D << std::endl;
+                    return false;
+                }
+
+                auto offset = params["offset"].as<std::vector<double>>();
+                _attractor = Eigen::Map<Vector>(offset.data());
+
+                return load(demo + "/models/" + params["first_order"]["name"].as<std::string>() + ".pt", params["first_order"]);
+            }
+
+            // Load model weights given its "first_order" configuration
+            bool load(const std::string& path, const YAML::Node& config)
+            {
+                if (config["embedding"]["type"].as<std::string>() != "network" || config["stiffness"].as<std::string>() != "full") {
+                    std::cerr << "Only network embedding and full stiffness are supported" << std::endl;
+                    return false;
+                }
+
+                tools::TorchArchive archive;
+                if (!archive.load(path))
+                    return false;
+
+                auto net = config["embedding"]["params"].as<std::vector<size_t>>();
+                covariances::SPD stiffness;
+
+                size_t k = _embedding.approximator().load(archive, 0, D, net[0], net[1]);
+                if (!k || !stiffness.load(archive, k, D))
+                    return false;
+
+                _stiffness = stiffness.matrix();
+
+                return true;
+            }
+
+            FirstGeometry& setAttractor(const Vector& a)
+            {
+                _attractor = a;
+                return *this;
+            }
+
+            const Vector& attractor() const { return _attractor; }
+
+            void evaluate(const Vector& x, Vector& y) override
+            {
+                _x = x - _attractor;
+                _embedding.update(_x);
+                y = -_embedding.metricInverse(_stiffness * _x);
+            }
+
+            // One network pass for the whole batch: g^-1 u = u - grad (grad . u) / (1 + |grad|^2)
+            void batch(const Inputs& X, Outputs& Y) override
+            {
+                _X = X.colwise() - _attractor;
+                _G.resize(D, X.cols());
+                _embedding.approximator().gradient(_X, _G);
+
+                _U.noalias() = _stiffness * _X;
+                Y = _G.array().rowwise() * ((_G.array() * _U.array()).colwise().sum() / (1.0 + _G.colwise().squaredNorm().array()));
+                Y -= _U;
+            }
+
+        protected:
+            Vector _attractor, _x;
+            Inputs _X, _U;
+            Eigen::MatrixXd _G;
+            Matrix _stiffness;
+            embedding::Embedding<D> _embedding;
+        };
+    } // namespace dynamics
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_DYNAMICS_FIRSTGEOMETRY_HPP
@@ -0,0 +1,81 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_DYNAMICS_LINEAR_HPP
+#define LEARNEMBEDDING_DYNAMICS_LINEAR_HPP
+
+#include "learn_embedding/dynamics/AbstractDynamics.hpp"
+
+namespace learn_embedding {
+    namespace dynamics {
+        /*
+            Analytic stand-in for the learned ds, same interface and attractor.
+
+            First order (In == Out): dx = -k (x - a)
+            Second order (In == 2 Out): ddx = -k (x - a) - d dx
+        */
+        template <int In, int Out>
+        class Linear : public AbstractDynamics<In, Out> {
+        public:
+            using Input = Eigen::Matrix<double, In, 1>;
+            using Output = Eigen::Matrix<double, Out, 1>;
+
+            Linear() : _attractor(Output::Zero()), _stiffness(1.0), _damping(2.0)
+            {
+                static_assert(In == Out || In == 2 * Out, "State must be position or position and velocity");
+            }
+
+            Linear& setAttractor(const Output& a)
+            {
+                _attractor = a;
+                return *this;
+            }
+
+            Linear& setStiffness(const double& k)
+            {
+                _stiffness = k;
+                return *this;
+            }
+
+            Linear& setDamping(const double& d)
+            {
+                _damping = d;
+                return *this;
+            }
+
+            void evaluate(const Input& x, Output& y) override
+            {
+                y = -_stiffness * (x.head(Out) - _attractor);
+                if (In != Out)
+                    y -= _damping * x.tail(Out);
+            }
+
+        protected:
+            Output _attractor;
+            double _stiffness, _damping;
+        };
+    } // namespace dynamics
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_DYNAMICS_LINEAR_HPP
@@ -0,0 +1,104 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+#ifndef LEARNEMBEDDING_DYNAMICS_PARITY_HPP
+#define LEARNEMBEDDING_DYNAMICS_PARITY_HPP
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "learn_embedding/dynamics/FirstGeometry.hpp"
+#include "learn_embedding/dynamics/SecondGeometry.hpp"
+
+namespace learn_embedding {
+    namespace dynamics {
+        /*
+            Check of the native models against the python ones. scripts/ds_golden.py dumps, once per
+            demo, reference rows (inputs then outputs) into models/golden_{first,second}.csv; python
+            evaluates in float32, so an output y must match its reference r within tolerance * (1 + |r|).
+        */
+        template <int In, int Out>
+        bool parity(const std::string& name, const std::string& path, AbstractDynamics<In, Out>& ds, const double& tolerance)
+        {
+            std::ifstream file(path);
+            if (!file.is_open()) {
+                std::cerr << "Missing " << path << " (run scripts/ds_golden.py)" << std::endl;
+                return false;
+            }
+
+            typename AbstractDynamics<In, Out>::Input x;
+            typename AbstractDynamics<In, Out>::Output y, reference;
+            double max_error = 0.0;
+            size_t samples = 0, worst = 0;
+
+            for (std::string line; std::getline(file, line);) {
+                if (line.find_first_not_of(" \t\r") == std::string::npos)
+                    continue;
+
+                std::istringstream row(line);
+                for (int i = 0; i < In; i++)
+                    row >> x(i);
+                for (int i = 0; i < Out; i++)
+                    row >> reference(i);
+                double extra;
+                if (row.fail() || row >> extra) {
+                    std::cerr << path << " row " << samples << " does not hold " << In << " inputs and " << Out << " outputs" << std::endl;
+                    return false;
+                }
+
+                ds.evaluate(x, y);
+                double error = (y - reference).norm() / (1.0 + reference.norm());
+                if (error > max_error) {
+                    max_error = error;
+                    worst = samples;
+                }
+                samples++;
+            }
+
+            bool passed = samples && max_error <= tolerance;
+            std::cout << name << ": " << samples << " samples, max relative error " << max_error
+                      << " (row " << worst << ") " << (passed ? "ok" : "FAILED") << std::endl;
+
+            return passed;
+        }
+
+        // Both models of a demo folder (e.g. rsc/demos/demo_2) against their golden files
+        template <int D>
+        bool parity(const std::string& demo, const double& tolerance = 1e-4)
+        {
+            FirstGeometry<D> first;
+            SecondGeometry<D> second;
+            if (!first.load(demo) || !second.load(demo))
+                return false;
+
+            bool passed = parity("first order", demo + "/models/golden_first.csv", first, tolerance);
+            return parity("second order", demo + "/models/golden_second.csv", second, tolerance) && passed;
+        }
+    } // namespace dynamics
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_DYNAMICS_PARITY_HPP
@@ -0,0 +1,134 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_DYNAMICS_SECONDGEOMETRY_HPP
+#define LEARNEMBEDDING_DYNAMICS_SECONDGEOMETRY_HPP
+
+#include <memory>
+
+#include "learn_embedding/dynamics/FirstGeometry.hpp"
+
+namespace learn_embedding {
+    namespace dynamics {
+        /*
+            Second order ds ddx = -g^-1(x) (K (x - a) + D (dx - w f(x))) - G(x)(dx, dx),
+            counterpart of learn_embedding.dynamics.SecondGeometry (forward_fast).
+            The first order field f is only used with directional dissipation.
+        */
+        template <int D>
+        class SecondGeometry : public AbstractDynamics<2 * D, D> {
+        public:
+            using Vector = Eigen::Matrix<double, D, 1>;
+            using State = Eigen::Matrix<double, 2 * D, 1>;
+            using Matrix = Eigen::Matrix<double, D, D>;
+
+            SecondGeometry() : _attractor(Vector::Zero()), _stiffness(Matrix::Identity()), _dissipation(Matrix::Identity()), _field_weight(0.0) {}
+
+            // Load "second_order" model of a demo folder (e.g. rsc/demos/demo_2)
+            bool load(const std::string& demo)
+            {
+                YAML::Node params = YAML::LoadFile(demo + "/dynamics_params.yaml");
+                if (params["dimension"].as<int>() != D) {
+                    std::cerr << "Model dimension does not match " << D << std::endl;
+                    return false;
+                }
+
+                auto offset = params["offset"].as<std::vector<double>>();
+                _attractor = Eigen::Map<Vector>(offset.data());
+
+                const YAML::Node& config = params["second_order"];
+                if (config["embedding"]["type"].as<std::string>() != "network" || config["stiffness"].as<std::string>() != "full" || config["dissipation"].as<std::string>() != "full") {
+                    std::cerr << "Only network embedding and full stiffness/dissipation are supported" << std::endl;
+                    return false;
+                }
+
+                tools::TorchArchive archive;
+                if (!archive.load(demo + "/models/" + config["name"].as<std::string>() + ".pt"))
+                    return false;
+
+                auto net = config["embedding"]["params"].as<std::vector<size_t>>();
+                covariances::SPD stiffness, dissipation;
+
+                size_t k = _embedding.approximator().load(archive, 0, D, net[0], net[1]);
+                if (!k || !(k = stiffness.load(archive, k, D)) || !dissipation.load(archive, k, D))
+                    return false;
+
+                _stiffness = stiffness.matrix();
+                _dissipation = dissipation.matrix();
+
+                // field and weight as in scripts/second_ds_control.py
+                if (config["options"]["directional_dissipation"].as<bool>()) {
+                    if (!config["options"]["field_weight"]) {
+                        std::cerr << "Directional dissipation needs second_order.options.field_weight" << std::endl;
+                        return false;
+                    }
+                    _field = std::make_shared<FirstGeometry<D>>();
+                    if (!_field->load(demo))
+                        return false;
+                    _field_weight = config["options"]["field_weight"].as<double>();
+                }
+
+                return true;
+            }
+
+            SecondGeometry& setAttractor(const Vector& a)
+            {
+                _attractor = a;
+                return *this;
+            }
+
+            SecondGeometry& setField(const std::shared_ptr<FirstGeometry<D>>& field, const double& weight)
+            {
+                _field = field;
+                _field_weight = weight;
+                return *this;
+            }
+
+            void evaluate(const State& x, Vector& y) override
+            {
+                _x = x.head(D) - _attractor;
+                _v = x.tail(D);
+
+                if (_field) {
+                    _field->evaluate(x.head(D), _f);
+                    _v -= _field_weight * _f;
+                }
+
+                _embedding.update(_x, true);
+                y = -_embedding.metricInverse(_stiffness * _x + _dissipation * _v) - _embedding.christoffel(x.tail(D));
+            }
+
+        protected:
+            Vector _attractor, _x, _v, _f;
+            Matrix _stiffness, _dissipation;
+            embedding::Embedding<D> _embedding;
+
+            // directional dissipation
+            std::shared_ptr<FirstGeometry<D>> _field;
+            double _field_weight;
+        };
+    } // namespace dynamics
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_DYNAMICS_SECONDGEOMETRY_HPP
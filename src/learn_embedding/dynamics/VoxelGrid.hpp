@@ -0,0 +1,219 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_DYNAMICS_VOXELGRID_HPP
+#define LEARNEMBEDDING_DYNAMICS_VOXELGRID_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "learn_embedding/dynamics/AbstractDynamics.hpp"
+
+namespace learn_embedding {
+    namespace dynamics {
+        /*
+            First order ds sampled on a regular grid and interpolated (trilinear in 3D).
+
+            The samples are produced offline by src/tools/ds_grid and stored as
+
+            uint32 magic, uint32 dimension, uint32 resolution[D], double lower[D], double upper[D],
+            float field[resolution product][D]
+
+            with the first axis running fastest. Queries outside the box are left to the caller.
+        */
+        template <int D>
+        class VoxelGrid : public AbstractDynamics<D, D> {
+        public:
+            using Vector = Eigen::Matrix<double, D, 1>;
+            using Index = Eigen::Matrix<uint32_t, D, 1>;
+
+            VoxelGrid() : _lower(Vector::Zero()), _upper(Vector::Zero()), _resolution(Index::Zero()) {}
+
+            // Sample ds over [lower, upper] with resolution (at least 2) nodes per axis; every thread works on its own copy of ds
+            template <typename Dynamics>
+            bool sample(const Dynamics& ds, const Vector& lower, const Vector& upper, const Index& resolution, size_t threads = std::thread::hardware_concurrency())
+            {
+                if ((resolution.array() < 2).any() || (upper.array() <= lower.array()).any()) {
+                    std::cerr << "Grid needs at least 2 nodes per axis and upper > lower" << std::endl;
+                    return false;
+                }
+
+                resize(lower, upper, resolution);
+
+                size_t nodes = _field.size() / D;
+                threads = std::max<size_t>(1, std::min(threads, nodes));
+
+                std::vector<std::thread> workers;
+                for (size_t t = 0; t < threads; t++)
+                    workers.emplace_back([&, t]() {
+                        Dynamics model(ds);
+                        Vector x, y;
+
+                        for (size_t n = t; n < nodes; n += threads) {
+                            node(n, x);
+                            model.evaluate(x, y);
+                            for (int d = 0; d < D; d++)
+                                _field[n * D + d] = static_cast<float>(y(d));
+                        }
+                    });
+
+                for (auto& worker : workers)
+                    worker.join();
+
+                return true;
+            }
+
+            bool save(const std::string& path) const
+            {
+                std::ofstream file(path, std::ios::binary);
+                if (!file.is_open()) {
+                    std::cerr << "Unable to open " << path << std::endl;
+                    return false;
+                }
+
+                uint32_t header[2] = {MAGIC, D};
+                file.write(reinterpret_cast<const char*>(header), sizeof(header));
+                file.write(reinterpret_cast<const char*>(_resolution.data()), D * sizeof(uint32_t));
+                file.write(reinterpret_cast<const char*>(_lower.data()), D * sizeof(double));
+                file.write(reinterpret_cast<const char*>(_upper.data()), D * sizeof(double));
+                file.write(reinterpret_cast<const char*>(_field.data()), _field.size() * sizeof(float));
+
+                return file.good();
+            }
+
+            bool load(const std::string& path)
+            {
+                std::ifstream file(path, std::ios::binary);
+                if (!file.is_open()) {
+                    std::cerr << "Unable to open " << path << std::endl;
+                    return false;
+                }
+
+                uint32_t header[2];
+                Index resolution;
+                Vector lower, upper;
+
+                file.read(reinterpret_cast<char*>(header), sizeof(header));
+                file.read(reinterpret_cast<char*>(resolution.data()), D * sizeof(uint32_t));
+                file.read(reinterpret_cast<char*>(lower.data()), D * sizeof(double));
+                file.read(reinterpret_cast<char*>(upper.data()), D * sizeof(double));
+                if (!file || header[0] != MAGIC || header[1] != D || (resolution.array() < 2).any()) {
+                    std::cerr << "Malformed grid " << path << std::endl;
+                    return false;
+                }
+
+                resize(lower, upper, resolution);
+                file.read(reinterpret_cast<char*>(_field.data()), _field.size() * sizeof(float));
+                if (!file) {
+                    std::cerr << "Truncated grid " << path << std::endl;
+                    return false;
+                }
+
+                return true;
+            }
+
+            const Vector& lower() const { return _lower; }
+
+            const Vector& upper() const { return _upper; }
+
+            const Index& resolution() const { return _resolution; }
+
+            bool contains(const Vector& x) const override
+            {
+                return (x.array() >= _lower.array()).all() && (x.array() <= _upper.array()).all();
+            }
+
+            // Multilinear interpolation of the 2^D surrounding nodes (clamped to the box)
+            void evaluate(const Vector& x, Vector& y) override
+            {
+                size_t base = 0;
+                double frac[D];
+
+                for (int d = 0; d < D; d++) {
+                    double s = std::min(std::max((x(d) - _lower(d)) * _scale(d), 0.0), double(_resolution(d) - 1));
+                    size_t i = std::min(static_cast<size_t>(s), size_t(_resolution(d) - 2));
+                    frac[d] = s - i;
+                    base += i * _stride[d];
+                }
+
+                y.setZero();
+                for (int c = 0; c < (1 << D); c++) {
+                    double w = 1.0;
+                    size_t n = base;
+                    for (int d = 0; d < D; d++) {
+                        if (c & (1 << d)) {
+                            w *= frac[d];
+                            n += _stride[d];
+                        }
+                        else
+                            w *= 1.0 - frac[d];
+                    }
+
+                    const float* v = &_field[n * D];
+                    for (int d = 0; d < D; d++)
+                        y(d) += w * v[d];
+                }
+            }
+
+        protected:
+            static constexpr uint32_t MAGIC = 0x4452474c; // "LGRD"
+
+            void resize(const Vector& lower, const Vector& upper, const Index& resolution)
+            {
+                _lower = lower;
+                _upper = upper;
+                _resolution = resolution;
+                _scale = (resolution.template cast<double>().array() - 1.0) / (upper - lower).array();
+
+                size_t nodes = 1;
+                for (int d = 0; d < D; d++) {
+                    _stride[d] = nodes;
+                    nodes *= resolution(d);
+                }
+                _field.assign(nodes * D, 0.0f);
+            }
+
+            // Position of the n-th node
+            void node(size_t n, Vector& x) const
+            {
+                for (int d = 0; d < D; d++) {
+                    x(d) = _lower(d) + (n % _resolution(d)) / _scale(d);
+                    n /= _resolution(d);
+                }
+            }
+
+            Vector _lower, _upper, _scale;
+            Index _resolution;
+            size_t _stride[D];
+            std::vector<float> _field;
+        };
+    } // namespace dynamics
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_DYNAMICS_VOXELGRID_HPP
@@ -0,0 +1,86 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_EMBEDDING_EMBEDDING_HPP
+#define LEARNEMBEDDING_EMBEDDING_EMBEDDING_HPP
+
+#include <Eigen/Core>
+
+#include "learn_embedding/approximators/FeedForward.hpp"
+
+namespace learn_embedding {
+    namespace embedding {
+        /*
+            Graph embedding x -> (x, psi(x)) of R^D into R^(D+1), counterpart of
+            learn_embedding.embedding.Embedding.
+
+            With the euclidean ambient metric the pullback metric is g = I + grad(psi) grad(psi)^T,
+            so its inverse has a closed form (Sherman-Morrison) and the Christoffel symbols
+            reduce to G^k_ij = (g^-1 grad(psi))_k d_ij(psi).
+        */
+        template <int D>
+        class Embedding {
+        public:
+            using Vector = Eigen::Matrix<double, D, 1>;
+            using Matrix = Eigen::Matrix<double, D, D>;
+
+            Embedding() : _grad(Vector::Zero()), _hess(Matrix::Zero()) {}
+
+            approximators::FeedForward& approximator() { return _approximator; }
+
+            // Embedding derivatives at x (Hessian only when the Christoffel symbols are needed)
+            void update(const Vector& x, const bool& hessian = false)
+            {
+                if (hessian)
+                    _approximator(x, _grad, _hess);
+                else
+                    _approximator(x, _grad);
+            }
+
+            const Vector& gradient() const { return _grad; }
+
+            const Matrix& hessian() const { return _hess; }
+
+            // Inverse pullback metric applied to u
+            Vector metricInverse(const Vector& u) const
+            {
+                return u - _grad * (_grad.dot(u) / (1.0 + _grad.squaredNorm()));
+            }
+
+            // Christoffel symbols contracted twice with v
+            Vector christoffel(const Vector& v) const
+            {
+                return metricInverse(_grad) * v.dot(_hess * v);
+            }
+
+        protected:
+            approximators::FeedForward _approximator;
+
+            Vector _grad;
+            Matrix _hess;
+        };
+    } // namespace embedding
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_EMBEDDING_EMBEDDING_HPP
@@ -0,0 +1,159 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_MODEL_FRANKADESCRIPTION_HPP
+#define LEARNEMBEDDING_MODEL_FRANKADESCRIPTION_HPP
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/jacobian.hpp>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/model/ModelCache.hpp"
+#include "learn_embedding/model/PandaKinematics.hpp"
+
+namespace learn_embedding {
+    namespace model {
+        /*
+            Immutable part of the Panda model: the pinocchio model of the urdf (from ModelCache,
+            parsed only when the cache misses), the end-effector frame and whether the
+            closed-form kernel agrees with it.
+
+            Nothing here changes after construction, so one description is shared (const) by
+            every FrankaWorkspace, whatever thread it runs on. load() parses each (urdf, frame)
+            pair once per process and hands out the same instance afterwards. A frame missing
+            from the urdf throws std::runtime_error.
+        */
+        template <int Dofs = 7>
+        class FrankaDescription {
+        public:
+            using Configuration = Eigen::Matrix<double, Dofs, 1>;
+            using Jacobian = Eigen::Matrix<double, 6, Dofs>;
+
+            FrankaDescription(const std::string& urdf = "rsc/franka/panda.urdf", const std::string& frame = "panda_joint8")
+                : _urdf(urdf), _frame(frame), _reference(pinocchio::LOCAL_WORLD_ALIGNED), _kernel(false)
+            {
+                ModelCache::build(urdf, _pin);
+
+                // frame names are taken as they appear in the urdf (the flange is panda_joint8)
+                if (!_pin.existFrame(_frame))
+                    throw std::runtime_error("Frame " + _frame + " not found in " + urdf);
+                _id = _pin.getFrameId(_frame);
+
+                if (_pin.nq != Dofs || _pin.nv != Dofs)
+                    std::cerr << urdf << " has " << _pin.nv << " dofs, expected " << Dofs << std::endl;
+                else if (_frame == "panda_joint8") {
+                    pinocchio::Data data(_pin);
+                    double error = crossCheck(data, 10);
+                    if (error < 1e-9)
+                        _kernel = true;
+                    else
+                        std::cerr << "Panda kernel disagrees with " << _frame << " by " << error << ", using pinocchio" << std::endl;
+                }
+            }
+
+            // Description of (urdf, frame) shared by the whole process, parsed on first request
+            static std::shared_ptr<const FrankaDescription> load(const std::string& urdf = "rsc/franka/panda.urdf", const std::string& frame = "panda_joint8")
+            {
+                static std::mutex mutex;
+                static std::map<std::pair<std::string, std::string>, std::shared_ptr<const FrankaDescription>> loaded;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                auto& description = loaded[{urdf, frame}];
+                if (!description)
+                    description = std::make_shared<const FrankaDescription>(urdf, frame);
+
+                return description;
+            }
+
+            const pinocchio::Model& model() const { return _pin; }
+
+            const pinocchio::FrameIndex& frameId() const { return _id; }
+
+            const std::string& urdf() const { return _urdf; }
+
+            const std::string& frame() const { return _frame; }
+
+            const pinocchio::ReferenceFrame& reference() const { return _reference; }
+
+            // Closed-form kernel validated against pinocchio for this frame
+            const bool& kernel() const { return _kernel; }
+
+            // Largest pose/Jacobian/derivative difference between kernel and pinocchio over n configurations within limits
+            double crossCheck(pinocchio::Data& data, const size_t& n) const
+            {
+                double error = 0.0;
+
+                if constexpr (Dofs == PandaKinematics::DOFS) {
+                    Configuration q, dq;
+                    Eigen::Matrix3d rotation;
+                    Eigen::Vector3d translation;
+                    Jacobian J, dJ, J_ref, dJ_ref;
+
+                    for (size_t i = 0; i < n; i++) {
+                        q = _pin.lowerPositionLimit + (Configuration::Random() + Configuration::Ones()).cwiseProduct(_pin.upperPositionLimit - _pin.lowerPositionLimit) * 0.5;
+                        dq = Configuration::Random();
+
+                        PandaKinematics::jacobianDerivative(q, dq, rotation, translation, J, dJ);
+
+                        pinocchio::computeJointJacobiansTimeVariation(_pin, data, q, dq);
+                        pinocchio::updateFramePlacement(_pin, data, _id);
+                        J_ref.setZero();
+                        dJ_ref.setZero();
+                        pinocchio::getFrameJacobian(_pin, data, _id, _reference, J_ref);
+                        pinocchio::getFrameJacobianTimeVariation(_pin, data, _id, _reference, dJ_ref);
+
+                        error = std::max({error,
+                            (rotation - data.oMf[_id].rotation()).cwiseAbs().maxCoeff(),
+                            (translation - data.oMf[_id].translation()).cwiseAbs().maxCoeff(),
+                            (J - J_ref).cwiseAbs().maxCoeff(),
+                            (dJ - dJ_ref).cwiseAbs().maxCoeff()});
+                    }
+                }
+
+                return error;
+            }
+
+        protected:
+            std::string _urdf, _frame;
+            pinocchio::ReferenceFrame _reference;
+
+            pinocchio::Model _pin;
+            pinocchio::FrameIndex _id;
+
+            bool _kernel;
+        };
+    } // namespace model
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_MODEL_FRANKADESCRIPTION_HPP
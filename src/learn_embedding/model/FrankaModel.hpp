@@ -0,0 +1,81 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_MODEL_FRANKAMODEL_HPP
+#define LEARNEMBEDDING_MODEL_FRANKAMODEL_HPP
+
+#include <memory>
+#include <string>
+
+#include <beautiful_bullet/bodies/MultiBody.hpp>
+
+#include "learn_embedding/model/FrankaWorkspace.hpp"
+
+namespace learn_embedding {
+    namespace model {
+        /*
+            Panda end-effector model shared by the controllers: the simulated (or planned) body
+            together with a FrankaWorkspace over the process-wide FrankaDescription of its urdf.
+
+            Queries through the model use its own workspace and are meant for the thread that
+            steps the body. Other threads (async controllers, rollouts) take workspace() and
+            evaluate on their own copy of pinocchio::Data, without locking or reparsing the urdf.
+
+            For the 7-dof Panda flange the kinematic pass is served by the closed-form
+            PandaKinematics kernel, once it has been cross-checked against pinocchio by the
+            description; gravity and nonlinear effects always come from pinocchio.
+        */
+        template <int Dofs = 7>
+        class FrankaModel : public beautiful_bullet::bodies::MultiBody, public FrankaWorkspace<Dofs> {
+        public:
+            using Workspace = FrankaWorkspace<Dofs>;
+            using typename Workspace::Configuration;
+            using typename Workspace::Description;
+            using typename Workspace::Jacobian;
+            using typename Workspace::Inertia;
+            using typename Workspace::Pose;
+            using typename Workspace::TaskInertia;
+
+            FrankaModel(const std::string& urdf = "rsc/franka/panda.urdf", const std::string& frame = "panda_joint8")
+                : beautiful_bullet::bodies::MultiBody(urdf), Workspace(Description::load(urdf, frame))
+            {
+            }
+
+            // Cached queries hide the per-call ones of MultiBody
+            using Workspace::frameVelocity;
+            using Workspace::framePose;
+            using Workspace::gravityVector;
+            using Workspace::inertiaMatrix;
+            using Workspace::jacobian;
+            using Workspace::jacobianDerivative;
+            using Workspace::nonLinearEffects;
+            using Workspace::update;
+
+            // Fresh workspace over the same description, for use on another thread
+            Workspace workspace() const { return Workspace(this->_description); }
+        };
+    } // namespace model
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_MODEL_FRANKAMODEL_HPP
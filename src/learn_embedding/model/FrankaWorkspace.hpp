@@ -0,0 +1,341 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_MODEL_FRANKAWORKSPACE_HPP
+#define LEARNEMBEDDING_MODEL_FRANKAWORKSPACE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <pinocchio/algorithm/crba.hpp>
+#include <pinocchio/algorithm/frames.hpp>
+#include <pinocchio/algorithm/jacobian.hpp>
+#include <pinocchio/algorithm/rnea.hpp>
+#include <pinocchio/spatial/explog.hpp>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+
+#include "learn_embedding/model/FrankaDescription.hpp"
+#include "learn_embedding/model/PandaKinematics.hpp"
+
+namespace learn_embedding {
+    namespace model {
+        /*
+            Per-thread evaluation state of a shared FrankaDescription.
+
+            Every quantity a control tick needs is cached against the (q, dq) it was computed at.
+            update() runs a single kinematic recursion that fills the frame placement, the frame
+            Jacobian and its time derivative; the frame velocity follows as J dq. Gravity and
+            nonlinear effects are computed at most once per key, on first request.
+            Accessors only recompute when called with a different state, so the controller and
+            the QP can ask for the same term several times within a tick for free.
+
+            Dimensions are fixed at compile time and the cache is preallocated: accessors either
+            return a reference to the cached term (valid until the next state) or copy it into a
+            caller-provided output, so no call allocates.
+
+            Joint-space inertia M(q) (CRBA), its Cholesky factor and the operational-space
+            inertia of the frame Lambda = (J M^-1 J^T)^-1 are cached the same way and shared
+            by every consumer of the tick. With setInertiaTolerance() M and its factor are kept
+            while q stays within the tolerance (max norm) of the configuration they were
+            computed at; Lambda is always rebuilt from the current J over the kept factor.
+
+            A workspace owns its pinocchio::Data and cache and only reads the description, so
+            threads evaluate concurrently by each holding their own workspace; constructing one
+            is a Data allocation, no urdf parsing.
+        */
+        template <int Dofs = 7>
+        class FrankaWorkspace {
+        public:
+            using Description = FrankaDescription<Dofs>;
+            using Configuration = Eigen::Matrix<double, Dofs, 1>;
+            using Jacobian = Eigen::Matrix<double, 6, Dofs>;
+            using Pose = Eigen::Matrix<double, 6, 1>;
+            using Inertia = Eigen::Matrix<double, Dofs, Dofs>;
+            using TaskInertia = Eigen::Matrix<double, 6, 6>;
+
+            FrankaWorkspace(const std::shared_ptr<const Description>& description = Description::load())
+                : _frame(description->frame()), _reference(description->reference()), _description(description), _data(description->model()),
+                  _kernel(description->kernel()), _tolerance(0.0), _passes(0), _hits(0), _factorizations(0)
+            {
+                _q.setZero();
+                _dq.setZero();
+                _jacobian.setZero();
+                _derivative.setZero();
+                _gravity.setZero();
+                _nonlinear.setZero();
+                _inertia.setIdentity();
+                _lambda.setIdentity();
+                _kinematics = _dynamics = _coriolis = _inertial = _task = false;
+            }
+
+            // Fill the cache for this tick; returns false when (q, dq) is already cached
+            template <typename Q, typename DQ>
+            bool update(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq)
+            {
+                if (_kinematics && q == _q && dq == _dq) {
+                    _hits++;
+                    return false;
+                }
+
+                if (!_kinematics || q != _q)
+                    _dynamics = _task = false;
+                _coriolis = false;
+                _q = q;
+                _dq = dq;
+
+                if constexpr (Dofs == PandaKinematics::DOFS) {
+                    if (_kernel) {
+                        Eigen::Matrix3d rotation;
+                        Eigen::Vector3d translation;
+                        PandaKinematics::jacobianDerivative(_q, _dq, rotation, translation, _jacobian, _derivative);
+                        _pose.template head<3>() = translation;
+                        _pose.template tail<3>() = pinocchio::log3(rotation);
+                    }
+                }
+
+                if (!_kernel) {
+                    const pinocchio::Model& pin = _description->model();
+                    const pinocchio::FrameIndex& id = _description->frameId();
+
+                    // placements, velocities, J and dJ of every joint in one recursion
+                    pinocchio::computeJointJacobiansTimeVariation(pin, _data, _q, _dq);
+                    pinocchio::updateFramePlacement(pin, _data, id);
+                    pinocchio::getFrameJacobian(pin, _data, id, _reference, _jacobian);
+                    pinocchio::getFrameJacobianTimeVariation(pin, _data, id, _reference, _derivative);
+                    _passes++;
+
+                    const pinocchio::SE3& placement = _data.oMf[id];
+                    _pose.template head<3>() = placement.translation();
+                    _pose.template tail<3>() = pinocchio::log3(placement.rotation());
+                }
+
+                _velocity.noalias() = _jacobian * _dq;
+
+                _kinematics = true;
+
+                return true;
+            }
+
+            template <typename Q>
+            const Jacobian& jacobian(const Eigen::MatrixBase<Q>& q)
+            {
+                position(q);
+                return _jacobian;
+            }
+
+            template <typename Q, typename DQ>
+            const Jacobian& jacobianDerivative(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq)
+            {
+                update(q, dq);
+                return _derivative;
+            }
+
+            template <typename Q>
+            const Pose& framePose(const Eigen::MatrixBase<Q>& q)
+            {
+                position(q);
+                return _pose;
+            }
+
+            template <typename Q, typename DQ>
+            const Pose& frameVelocity(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq)
+            {
+                update(q, dq);
+                return _velocity;
+            }
+
+            template <typename Q>
+            const Configuration& gravityVector(const Eigen::MatrixBase<Q>& q)
+            {
+                position(q);
+                if (!_dynamics) {
+                    _gravity = pinocchio::computeGeneralizedGravity(_description->model(), _data, _q);
+                    _dynamics = true;
+                    _passes++;
+                }
+                return _gravity;
+            }
+
+            template <typename Q, typename DQ>
+            const Configuration& nonLinearEffects(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq)
+            {
+                update(q, dq);
+                if (!_coriolis) {
+                    _nonlinear = pinocchio::nonLinearEffects(_description->model(), _data, _q, _dq);
+                    _coriolis = true;
+                    _passes++;
+                }
+                return _nonlinear;
+            }
+
+            // Joint-space inertia, reused within the inertia tolerance
+            template <typename Q>
+            const Inertia& inertiaMatrix(const Eigen::MatrixBase<Q>& q)
+            {
+                position(q);
+                if (!_inertial || (_q - _q_inertia).cwiseAbs().maxCoeff() > _tolerance) {
+                    // crba fills the upper triangle only
+                    _inertia = pinocchio::crba(_description->model(), _data, _q);
+                    _inertia.template triangularView<Eigen::StrictlyLower>() = _inertia.transpose();
+                    _factor.compute(_inertia);
+                    _q_inertia = _q;
+                    _inertial = true;
+                    _task = false;
+                    _factorizations++;
+                    _passes++;
+                }
+                return _inertia;
+            }
+
+            // Cholesky factor of inertiaMatrix(q), e.g. for M^-1 x = inertiaFactor(q).solve(x)
+            template <typename Q>
+            const Eigen::LLT<Inertia>& inertiaFactor(const Eigen::MatrixBase<Q>& q)
+            {
+                inertiaMatrix(q);
+                return _factor;
+            }
+
+            // Operational-space inertia of the frame, (J M^-1 J^T)^-1
+            template <typename Q>
+            const TaskInertia& taskInertia(const Eigen::MatrixBase<Q>& q)
+            {
+                inertiaMatrix(q);
+                if (!_task) {
+                    _mobility.noalias() = _factor.solve(_jacobian.transpose());
+                    _inverse.noalias() = _jacobian * _mobility;
+                    _lambda.setIdentity();
+                    _task_factor.compute(_inverse);
+                    _task_factor.solveInPlace(_lambda);
+                    _task = true;
+                }
+                return _lambda;
+            }
+
+            // Max-norm distance in q within which M and its factor are reused (0 recomputes on any change)
+            FrankaWorkspace& setInertiaTolerance(const double& tolerance)
+            {
+                _tolerance = tolerance;
+                return *this;
+            }
+
+            // Same terms written into caller-provided outputs
+            template <typename Q>
+            void jacobian(const Eigen::MatrixBase<Q>& q, Jacobian& J) { J = jacobian(q); }
+
+            template <typename Q, typename DQ>
+            void jacobianDerivative(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq, Jacobian& dJ) { dJ = jacobianDerivative(q, dq); }
+
+            template <typename Q>
+            void framePose(const Eigen::MatrixBase<Q>& q, Pose& pose) { pose = framePose(q); }
+
+            template <typename Q, typename DQ>
+            void frameVelocity(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq, Pose& velocity) { velocity = frameVelocity(q, dq); }
+
+            template <typename Q>
+            void gravityVector(const Eigen::MatrixBase<Q>& q, Configuration& g) { g = gravityVector(q); }
+
+            template <typename Q, typename DQ>
+            void nonLinearEffects(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq, Configuration& nle) { nle = nonLinearEffects(q, dq); }
+
+            template <typename Q>
+            void inertiaMatrix(const Eigen::MatrixBase<Q>& q, Inertia& M) { M = inertiaMatrix(q); }
+
+            template <typename Q>
+            void taskInertia(const Eigen::MatrixBase<Q>& q, TaskInertia& lambda) { lambda = taskInertia(q); }
+
+            // Use the closed-form kernel for the kinematic pass; refused if the description did not validate it
+            FrankaWorkspace& setKernel(const bool& kernel)
+            {
+                _kernel = kernel && _description->kernel();
+                _kinematics = false;
+                return *this;
+            }
+
+            const bool& kernel() const { return _kernel; }
+
+            // Cross-check of kernel and pinocchio on this workspace's data (see FrankaDescription::crossCheck)
+            double crossCheck(const size_t& n)
+            {
+                return _description->crossCheck(_data, n);
+            }
+
+            const std::shared_ptr<const Description>& description() const { return _description; }
+
+            // Pinocchio recursions run so far
+            const uint64_t& passes() const { return _passes; }
+
+            // Requests served from the cache
+            const uint64_t& hits() const { return _hits; }
+
+            // CRBA + Cholesky runs so far (also counted in passes)
+            const uint64_t& factorizations() const { return _factorizations; }
+
+            std::string _frame;
+            pinocchio::ReferenceFrame _reference;
+
+        protected:
+            // Position-level terms only depend on q, keep whatever dq is cached
+            template <typename Q>
+            void position(const Eigen::MatrixBase<Q>& q)
+            {
+                if (!_kinematics || q != _q)
+                    update(q, Configuration::Zero());
+                else
+                    _hits++;
+            }
+
+            std::shared_ptr<const Description> _description;
+            pinocchio::Data _data;
+
+            // closed-form kinematic pass
+            bool _kernel;
+
+            // cache key
+            Configuration _q, _dq;
+            bool _kinematics, _dynamics, _coriolis;
+
+            // cached terms
+            Pose _pose, _velocity;
+            Jacobian _jacobian, _derivative;
+            Configuration _gravity, _nonlinear;
+
+            // inertia cache, keyed by the configuration M was computed at
+            double _tolerance;
+            Configuration _q_inertia;
+            bool _inertial, _task;
+            Inertia _inertia;
+            Eigen::LLT<Inertia> _factor;
+            Eigen::Matrix<double, Dofs, 6> _mobility;
+            TaskInertia _inverse, _lambda;
+            Eigen::LDLT<TaskInertia> _task_factor;
+
+            uint64_t _passes, _hits, _factorizations;
+        };
+    } // namespace model
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_MODEL_FRANKAWORKSPACE_HPP
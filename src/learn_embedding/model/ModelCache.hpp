@@ -0,0 +1,184 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_MODEL_MODELCACHE_HPP
+#define LEARNEMBEDDING_MODEL_MODELCACHE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <pinocchio/parsers/urdf.hpp>
+#include <pinocchio/serialization/model.hpp>
+
+namespace learn_embedding {
+    namespace model {
+        /*
+            Binary cache of pinocchio models parsed from urdf files.
+
+            The cache of "<dir>/<name>.urdf" is "<dir>/<name>.urdf.<hash>.bin", with the hash
+            taken over the urdf text and the pinocchio version, so editing the urdf or
+            upgrading pinocchio simply misses the old file. A hit maps the file and
+            deserializes the model straight from the mapping; a miss parses the urdf and writes
+            the cache (to a temporary, then renamed, so concurrent workers never read half a
+            file). Unwritable directories only cost the parse.
+        */
+        class ModelCache {
+        public:
+            // Model of urdf, from the cache when present; false if the urdf cannot be read
+            static bool build(const std::string& urdf, pinocchio::Model& model)
+            {
+                std::string xml;
+                if (!read(urdf, xml)) {
+                    std::cerr << "Unable to open " << urdf << std::endl;
+                    return false;
+                }
+
+                std::string cache = path(urdf, hash(xml));
+                if (load(cache, model))
+                    return true;
+
+                model = pinocchio::Model();
+                pinocchio::urdf::buildModelFromXML(xml, model);
+                save(cache, model);
+
+                return true;
+            }
+
+            // Cache file of a urdf with the given text hash
+            static std::string path(const std::string& urdf, const uint64_t& key)
+            {
+                char hex[17];
+                std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+                return urdf + "." + hex + ".bin";
+            }
+
+            // FNV-1a of the urdf text and the pinocchio version
+            static uint64_t hash(const std::string& xml)
+            {
+                uint64_t h = 0xcbf29ce484222325ULL;
+                auto mix = [&h](const std::string& text) {
+                    for (const char& c : text) {
+                        h ^= static_cast<unsigned char>(c);
+                        h *= 0x100000001b3ULL;
+                    }
+                };
+
+                mix(xml);
+#ifdef PINOCCHIO_VERSION
+                mix(PINOCCHIO_VERSION);
+#endif
+
+                return h;
+            }
+
+            static bool load(const std::string& cache, pinocchio::Model& model)
+            {
+                int fd = open(cache.c_str(), O_RDONLY);
+                if (fd < 0)
+                    return false;
+
+                struct stat info;
+                if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                    close(fd);
+                    return false;
+                }
+
+                void* ptr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                close(fd);
+                if (ptr == MAP_FAILED)
+                    return false;
+
+                bool loaded = true;
+                try {
+                    Mapping buffer(static_cast<char*>(ptr), info.st_size);
+                    std::istream stream(&buffer);
+                    boost::archive::binary_iarchive archive(stream);
+                    archive >> model;
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Discarding model cache " << cache << ": " << e.what() << std::endl;
+                    loaded = false;
+                }
+
+                munmap(ptr, info.st_size);
+
+                return loaded;
+            }
+
+            static bool save(const std::string& cache, const pinocchio::Model& model)
+            {
+                std::string temporary = cache + "." + std::to_string(getpid());
+
+                {
+                    std::ofstream file(temporary, std::ios::binary);
+                    if (!file.is_open())
+                        return false;
+                    boost::archive::binary_oarchive archive(file);
+                    archive << model;
+                }
+
+                if (std::rename(temporary.c_str(), cache.c_str()) != 0) {
+                    std::remove(temporary.c_str());
+                    return false;
+                }
+
+                return true;
+            }
+
+        protected:
+            // Read-only stream buffer over the mapped cache
+            struct Mapping : public std::streambuf {
+                Mapping(char* data, const size_t& size) { setg(data, data, data + size); }
+            };
+
+            static bool read(const std::string& urdf, std::string& xml)
+            {
+                std::ifstream file(urdf, std::ios::binary);
+                if (!file.is_open())
+                    return false;
+
+                std::ostringstream text;
+                text << file.rdbuf();
+                xml = text.str();
+
+                return true;
+            }
+        };
+    } // namespace model
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_MODEL_MODELCACHE_HPP
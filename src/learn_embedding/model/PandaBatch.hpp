@@ -0,0 +1,247 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_MODEL_PANDABATCH_HPP
+#define LEARNEMBEDDING_MODEL_PANDABATCH_HPP
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/model/PandaKinematics.hpp"
+
+namespace learn_embedding {
+    namespace model {
+        /*
+            Batched PandaKinematics over many configurations, e.g. for end-effector traces of
+            logged joint states or workspace sampling.
+
+            Configurations come in structure-of-arrays layout, one row per sample and one
+            contiguous column per joint; results are laid out the same way, one column per
+            output entry. Samples are processed LANES at a time: every scalar of the chain
+            becomes a fixed-size array holding the same quantity for LANES configurations,
+            so each operation is a SIMD operation across samples. Chunks of LANES samples are
+            interleaved across threads.
+        */
+        class PandaBatch {
+        public:
+            static constexpr int DOFS = PandaKinematics::DOFS;
+            static constexpr int LANES = 8;
+
+            using Joints = Eigen::Matrix<double, Eigen::Dynamic, DOFS>;
+
+            // Flange positions (N x 3) and rotations (N x 9, column-major entries of R)
+            static void pose(const Eigen::Ref<const Joints>& q, Eigen::MatrixXd& positions, Eigen::MatrixXd& rotations,
+                size_t threads = std::thread::hardware_concurrency())
+            {
+                evaluate<false>(q, positions, rotations, nullptr, threads);
+            }
+
+            // Also the LOCAL_WORLD_ALIGNED Jacobians (N x 42, entry (r, c) of J in column 6 c + r)
+            static void jacobian(const Eigen::Ref<const Joints>& q, Eigen::MatrixXd& positions, Eigen::MatrixXd& rotations, Eigen::MatrixXd& jacobians,
+                size_t threads = std::thread::hardware_concurrency())
+            {
+                evaluate<true>(q, positions, rotations, &jacobians, threads);
+            }
+
+        protected:
+            using Lanes = Eigen::Array<double, LANES, 1>;
+
+            struct Vector {
+                Lanes x, y, z;
+            };
+
+            static void cross(const Vector& a, const Vector& b, Vector& out)
+            {
+                out.x = a.y * b.z - a.z * b.y;
+                out.y = a.z * b.x - a.x * b.z;
+                out.z = a.x * b.y - a.y * b.x;
+            }
+
+            /*
+                sin and cos of every lane with arithmetic only (Eigen does not vectorize them for
+                doubles): reduction to [-pi/4, pi/4] around the nearest multiple k of pi/2 with
+                pi/2 split in two parts, the Cephes polynomials on the remainder, then the pair is
+                swapped and negated according to the quadrant k mod 4. Rounding uses the 1.5 2^52
+                shift rather than round()/floor(), which need SSE4.1 to vectorize.
+            */
+            static void sincos(const Lanes& x, Lanes& sin, Lanes& cos)
+            {
+                Lanes k = nearest(x * 0.63661977236758134308),
+                      r = (x - k * 1.57079632673412561417e+00) - k * 6.07710050650619224932e-11,
+                      z = r * r;
+
+                Lanes s = r + r * z * (((((1.58962301576546568060e-10 * z - 2.50507477628578072866e-8) * z + 2.75573136213857245213e-6) * z - 1.98412698295895385996e-4) * z + 8.33333333332211858878e-3) * z - 1.66666666666666307295e-1),
+                      c = 1.0 - 0.5 * z + z * z * (((((-1.13585365213876817300e-11 * z + 2.08757008419747316778e-9) * z - 2.75573141792967388112e-7) * z + 2.48015872888517045348e-5) * z - 1.38888888888730564116e-3) * z + 4.16666666666665929218e-2);
+
+                // quadrant m in {0, 1, 2, 3}; floor(n / 4) = nearest(n / 4 - 3 / 8) and floor(m / 2) = nearest(m / 2 - 1 / 4) for integer n, m
+                Lanes m = k - 4.0 * nearest(0.25 * k - 0.375),
+                      half = nearest(0.5 * m - 0.25), odd = m - 2.0 * half,
+                      next = m + 1.0 - 4.0 * nearest(0.25 * m - 0.125);
+
+                sin = (1.0 - 2.0 * half) * (s + odd * (c - s));
+                cos = (1.0 - 2.0 * nearest(0.5 * next - 0.25)) * (c + odd * (s - c));
+            }
+
+            // Round to the nearest integer, for |x| < 2^51
+            static Lanes nearest(const Lanes& x)
+            {
+                constexpr double shift = 6755399441055744.0;
+                return (x + shift) - shift;
+            }
+
+            // Same chain as PandaKinematics, one configuration per lane
+            struct Chain {
+                Chain(const Lanes* q)
+                {
+                    R[0] = {Lanes::Ones(), Lanes::Zero(), Lanes::Zero()};
+                    R[1] = {Lanes::Zero(), Lanes::Ones(), Lanes::Zero()};
+                    R[2] = {Lanes::Zero(), Lanes::Zero(), Lanes::Ones()};
+                    p = {Lanes::Zero(), Lanes::Zero(), Lanes::Zero()};
+
+                    for (int i = 0; i < DOFS; i++)
+                        sincos(q[i], s[i], c[i]);
+                    links(std::make_index_sequence<DOFS>());
+                    offset<DOFS>();
+                }
+
+                template <size_t... I>
+                void links(std::index_sequence<I...>) { (link<I>(), ...); }
+
+                template <size_t I>
+                void link()
+                {
+                    offset<I>();
+                    axes[I] = R[2];
+                    origins[I] = p;
+
+                    // rotation about the joint z axis
+                    Vector x = R[0];
+                    R[0].x = c[I] * x.x + s[I] * R[1].x;
+                    R[0].y = c[I] * x.y + s[I] * R[1].y;
+                    R[0].z = c[I] * x.z + s[I] * R[1].z;
+                    R[1].x = c[I] * R[1].x - s[I] * x.x;
+                    R[1].y = c[I] * R[1].y - s[I] * x.y;
+                    R[1].z = c[I] * R[1].z - s[I] * x.z;
+                }
+
+                template <size_t I>
+                void offset()
+                {
+                    constexpr PandaKinematics::Joint joint = PandaKinematics::JOINTS[I];
+
+                    if constexpr (joint.x != 0.0)
+                        add(joint.x, R[0]);
+                    if constexpr (joint.y != 0.0)
+                        add(joint.y, R[1]);
+                    if constexpr (joint.z != 0.0)
+                        add(joint.z, R[2]);
+
+                    if constexpr (joint.roll == 1) {
+                        Vector y = R[1];
+                        R[1] = R[2];
+                        R[2] = {-y.x, -y.y, -y.z};
+                    }
+                    else if constexpr (joint.roll == -1) {
+                        Vector y = R[1];
+                        R[1] = {-R[2].x, -R[2].y, -R[2].z};
+                        R[2] = y;
+                    }
+                }
+
+                void add(const double& length, const Vector& axis)
+                {
+                    p.x += length * axis.x;
+                    p.y += length * axis.y;
+                    p.z += length * axis.z;
+                }
+
+                Lanes c[DOFS], s[DOFS];
+                Vector R[3], p, axes[DOFS], origins[DOFS];
+            };
+
+            template <bool Jacobians>
+            static void evaluate(const Eigen::Ref<const Joints>& q, Eigen::MatrixXd& positions, Eigen::MatrixXd& rotations, Eigen::MatrixXd* jacobians, size_t threads)
+            {
+                Eigen::Index samples = q.rows(), chunks = (samples + LANES - 1) / LANES;
+                positions.resize(samples, 3);
+                rotations.resize(samples, 9);
+                if constexpr (Jacobians)
+                    jacobians->resize(samples, 6 * DOFS);
+
+                threads = std::max<size_t>(1, std::min<size_t>(threads, chunks));
+
+                auto work = [&](const size_t& t) {
+                    Lanes lanes[DOFS];
+                    Vector arm;
+
+                    for (Eigen::Index n = t; n < chunks; n += threads) {
+                        Eigen::Index start = n * LANES, count = std::min<Eigen::Index>(LANES, samples - start);
+
+                        // partial chunks are padded with the zero configuration
+                        for (int j = 0; j < DOFS; j++) {
+                            lanes[j].setZero();
+                            lanes[j].head(count) = q.col(j).segment(start, count);
+                        }
+
+                        Chain chain(lanes);
+
+                        store(positions, 0, start, count, chain.p);
+                        for (int k = 0; k < 3; k++)
+                            store(rotations, 3 * k, start, count, chain.R[k]);
+
+                        if constexpr (Jacobians) {
+                            for (int i = 0; i < DOFS; i++) {
+                                cross(chain.axes[i], {chain.p.x - chain.origins[i].x, chain.p.y - chain.origins[i].y, chain.p.z - chain.origins[i].z}, arm);
+                                store(*jacobians, 6 * i, start, count, arm);
+                                store(*jacobians, 6 * i + 3, start, count, chain.axes[i]);
+                            }
+                        }
+                    }
+                };
+
+                if (threads == 1)
+                    return work(0);
+
+                std::vector<std::thread> workers;
+                for (size_t t = 0; t < threads; t++)
+                    workers.emplace_back(work, t);
+                for (auto& worker : workers)
+                    worker.join();
+            }
+
+            static void store(Eigen::MatrixXd& out, const Eigen::Index& col, const Eigen::Index& start, const Eigen::Index& count, const Vector& v)
+            {
+                out.col(col).segment(start, count) = v.x.head(count);
+                out.col(col + 1).segment(start, count) = v.y.head(count);
+                out.col(col + 2).segment(start, count) = v.z.head(count);
+            }
+        };
+    } // namespace model
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_MODEL_PANDABATCH_HPP
@@ -0,0 +1,188 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_MODEL_PANDAKINEMATICS_HPP
+#define LEARNEMBEDDING_MODEL_PANDAKINEMATICS_HPP
+
+#include <cmath>
+#include <utility>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace learn_embedding {
+    namespace model {
+        /*
+            Closed-form kinematics of the Panda arm up to panda_joint8 (the flange).
+
+            The joint origins of rsc/franka/panda.urdf are compile-time constants: every origin
+            is a translation followed by a roll of 0 or +-90 degrees, so the chain reduces to
+            column swaps and axis-aligned offsets, and the joint loop is unrolled. sin/cos of the
+            configuration are evaluated once and shared by pose, Jacobian and its derivative.
+            Jacobians are expressed as pinocchio's LOCAL_WORLD_ALIGNED frame Jacobian:
+            linear velocity of the flange origin and angular velocity, both in world axes.
+        */
+        class PandaKinematics {
+        public:
+            static constexpr int DOFS = 7;
+
+            using Configuration = Eigen::Matrix<double, DOFS, 1>;
+            using Jacobian = Eigen::Matrix<double, 6, DOFS>;
+
+            // origin of each joint in its parent frame: translation and roll in quarter turns
+            struct Joint {
+                double x, y, z;
+                int roll;
+            };
+
+            static constexpr Joint JOINTS[DOFS + 1] = {
+                {0.0, 0.0, 0.333, 0},
+                {0.0, 0.0, 0.0, -1},
+                {0.0, -0.316, 0.0, 1},
+                {0.0825, 0.0, 0.0, 1},
+                {-0.0825, 0.384, 0.0, -1},
+                {0.0, 0.0, 0.0, 1},
+                {0.088, 0.0, 0.0, 1},
+                {0.0, 0.0, 0.107, 0}, // fixed flange joint
+            };
+
+            // Flange rotation and position
+            template <typename Q>
+            static void pose(const Eigen::MatrixBase<Q>& q, Eigen::Matrix3d& R, Eigen::Vector3d& p)
+            {
+                Chain chain(q);
+                R = chain.R;
+                p = chain.p;
+            }
+
+            // Flange rotation, position and Jacobian
+            template <typename Q>
+            static void jacobian(const Eigen::MatrixBase<Q>& q, Eigen::Matrix3d& R, Eigen::Vector3d& p, Jacobian& J)
+            {
+                Chain chain(q);
+                R = chain.R;
+                p = chain.p;
+                chain.jacobian(J);
+            }
+
+            // Flange rotation, position, Jacobian and its time derivative along dq
+            template <typename Q, typename DQ>
+            static void jacobianDerivative(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq,
+                Eigen::Matrix3d& R, Eigen::Vector3d& p, Jacobian& J, Jacobian& dJ)
+            {
+                Chain chain(q);
+                R = chain.R;
+                p = chain.p;
+                chain.jacobian(J);
+
+                // angular velocity and origin velocity of the link carrying each joint
+                Eigen::Vector3d omega = Eigen::Vector3d::Zero(), v = Eigen::Vector3d::Zero(), prev = chain.origins[0];
+                Eigen::Vector3d velocities[DOFS], rates[DOFS];
+                for (int i = 0; i < DOFS; i++) {
+                    v += omega.cross(chain.origins[i] - prev);
+                    prev = chain.origins[i];
+                    velocities[i] = v;
+                    rates[i] = omega.cross(chain.axes[i]);
+                    omega += chain.axes[i] * dq(i);
+                }
+                Eigen::Vector3d flange = v + omega.cross(chain.p - prev);
+
+                for (int i = 0; i < DOFS; i++) {
+                    dJ.template block<3, 1>(0, i) = rates[i].cross(chain.p - chain.origins[i]) + chain.axes[i].cross(flange - velocities[i]);
+                    dJ.template block<3, 1>(3, i) = rates[i];
+                }
+            }
+
+        protected:
+            // Forward pass keeping the world axis and origin of every joint
+            struct Chain {
+                template <typename Q>
+                Chain(const Eigen::MatrixBase<Q>& q) : R(Eigen::Matrix3d::Identity()), p(Eigen::Vector3d::Zero())
+                {
+                    for (int i = 0; i < DOFS; i++) {
+                        c[i] = std::cos(q(i));
+                        s[i] = std::sin(q(i));
+                    }
+                    links(std::make_index_sequence<DOFS>());
+                    offset<DOFS>();
+                }
+
+                void jacobian(Jacobian& J) const
+                {
+                    for (int i = 0; i < DOFS; i++) {
+                        J.template block<3, 1>(0, i) = axes[i].cross(p - origins[i]);
+                        J.template block<3, 1>(3, i) = axes[i];
+                    }
+                }
+
+                template <size_t... I>
+                void links(std::index_sequence<I...>) { (link<I>(), ...); }
+
+                template <size_t I>
+                void link()
+                {
+                    offset<I>();
+                    axes[I] = R.col(2);
+                    origins[I] = p;
+
+                    // rotation about the joint z axis
+                    Eigen::Vector3d x = R.col(0);
+                    R.col(0) = c[I] * x + s[I] * R.col(1);
+                    R.col(1) = c[I] * R.col(1) - s[I] * x;
+                }
+
+                template <size_t I>
+                void offset()
+                {
+                    constexpr Joint joint = JOINTS[I];
+
+                    if constexpr (joint.x != 0.0)
+                        p += joint.x * R.col(0);
+                    if constexpr (joint.y != 0.0)
+                        p += joint.y * R.col(1);
+                    if constexpr (joint.z != 0.0)
+                        p += joint.z * R.col(2);
+
+                    // roll by +-90 degrees: y and z axes swap, one of them flips
+                    if constexpr (joint.roll == 1) {
+                        Eigen::Vector3d y = R.col(1);
+                        R.col(1) = R.col(2);
+                        R.col(2) = -y;
+                    }
+                    else if constexpr (joint.roll == -1) {
+                        Eigen::Vector3d y = R.col(1);
+                        R.col(1) = -R.col(2);
+                        R.col(2) = y;
+                    }
+                }
+
+                double c[DOFS], s[DOFS];
+                Eigen::Matrix3d R;
+                Eigen::Vector3d p, axes[DOFS], origins[DOFS];
+            };
+        };
+    } // namespace model
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_MODEL_PANDAKINEMATICS_HPP
@@ -0,0 +1,240 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_OPTIMIZATION_BOXPROGRAM_HPP
+#define LEARNEMBEDDING_OPTIMIZATION_BOXPROGRAM_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+
+namespace learn_embedding {
+    namespace optimization {
+        /*
+            Strictly convex QP with bounds on the variables only,
+
+                min 1/2 x^T H x + g^T x    s.t.    l <= x <= u,
+
+            solved exactly by a primal active-set method: variables are either free or held
+            at one of their bounds; each iteration minimizes over the free ones (one Cholesky
+            of H with the held rows and columns replaced by identity), then either steps
+            until the first free variable hits a bound and holds it, or releases the held
+            variable whose multiplier has the wrong sign. Every iterate is feasible and no
+            worse than the previous one, so stopping early still returns a usable point.
+
+            With warm start (default) the active set and the point carry over to the next
+            solve: when the set does not change between control ticks a solve is a single
+            factorization. Sizes are fixed at compile time; solve() never allocates.
+        */
+        template <int N>
+        class BoxProgram {
+        public:
+            using Vector = Eigen::Matrix<double, N, 1>;
+            using Hessian = Eigen::Matrix<double, N, N>;
+
+            enum Status {
+                SOLVED,
+                MAX_ITERATIONS
+            };
+
+            BoxProgram() : _max_iterations(4 * N + 10), _warm(true), _iterations(0), _factorizations(0)
+            {
+                _H.setIdentity();
+                _g.setZero();
+                _l.setConstant(-INFINITY);
+                _u.setConstant(INFINITY);
+                reset();
+            }
+
+            // Problem data, written in place before each solve
+            Hessian& hessian() { return _H; }
+
+            Vector& gradient() { return _g; }
+
+            Vector& lower() { return _l; }
+
+            Vector& upper() { return _u; }
+
+            // Keep active set and point between solves
+            BoxProgram& setWarmStart(const bool& warm)
+            {
+                _warm = warm;
+                return *this;
+            }
+
+            BoxProgram& setMaxIterations(const size_t& iterations)
+            {
+                _max_iterations = iterations;
+                return *this;
+            }
+
+            // Forget the previous solution
+            void reset()
+            {
+                _x.setZero();
+                _bound.setZero();
+            }
+
+            Status solve()
+            {
+                if (!_warm)
+                    reset();
+
+                // feasible start: held variables on their bound, free ones clamped
+                for (int i = 0; i < N; i++) {
+                    if (_u(i) - _l(i) <= EPSILON)
+                        _bound(i) = LOWER; // fixed
+                    else if ((_bound(i) == LOWER && !std::isfinite(_l(i))) || (_bound(i) == UPPER && !std::isfinite(_u(i))))
+                        _bound(i) = FREE;
+
+                    _x(i) = _bound(i) == LOWER ? _l(i) : (_bound(i) == UPPER ? _u(i) : std::min(std::max(_x(i), _l(i)), _u(i)));
+                }
+
+                for (_iterations = 1; _iterations <= _max_iterations; _iterations++) {
+                    minimize();
+
+                    // step towards the minimizer until the first free variable hits a bound
+                    double step = 1.0;
+                    int blocking = -1;
+                    int8_t side = FREE;
+                    for (int i = 0; i < N; i++) {
+                        if (_bound(i) != FREE)
+                            continue;
+                        if (_target(i) < _l(i) && (_l(i) - _x(i)) / (_target(i) - _x(i)) < step) {
+                            step = (_l(i) - _x(i)) / (_target(i) - _x(i));
+                            blocking = i;
+                            side = LOWER;
+                        }
+                        else if (_target(i) > _u(i) && (_u(i) - _x(i)) / (_target(i) - _x(i)) < step) {
+                            step = (_u(i) - _x(i)) / (_target(i) - _x(i));
+                            blocking = i;
+                            side = UPPER;
+                        }
+                    }
+
+                    _x += step * (_target - _x);
+
+                    if (blocking >= 0) {
+                        _bound(blocking) = side;
+                        _x(blocking) = side == LOWER ? _l(blocking) : _u(blocking);
+                        continue;
+                    }
+
+                    // optimal over the free variables: release the most violated held one, if any
+                    _gradient.noalias() = _H * _x;
+                    _gradient += _g;
+
+                    double worst = -1e-9 * (1.0 + _gradient.cwiseAbs().maxCoeff());
+                    int release = -1;
+                    for (int i = 0; i < N; i++) {
+                        if (_bound(i) == FREE || _u(i) - _l(i) <= EPSILON)
+                            continue;
+                        double multiplier = _bound(i) == LOWER ? _gradient(i) : -_gradient(i);
+                        if (multiplier < worst) {
+                            worst = multiplier;
+                            release = i;
+                        }
+                    }
+
+                    if (release < 0)
+                        return SOLVED;
+
+                    _bound(release) = FREE;
+                }
+                _iterations = _max_iterations;
+
+                return MAX_ITERATIONS;
+            }
+
+            const Vector& solution() const { return _x; }
+
+            // Iterations of the last solve
+            const size_t& iterations() const { return _iterations; }
+
+            // Factorizations so far (one per iteration)
+            const uint64_t& factorizations() const { return _factorizations; }
+
+            // Variables held at one of their bounds (fixed ones excluded)
+            size_t active() const
+            {
+                size_t count = 0;
+                for (int i = 0; i < N; i++)
+                    if (_bound(i) != FREE && _u(i) - _l(i) > EPSILON)
+                        count++;
+                return count;
+            }
+
+        protected:
+            static constexpr int8_t FREE = 0, LOWER = -1, UPPER = 1;
+            static constexpr double EPSILON = 1e-12;
+
+            // Minimizer over the free variables with the held ones at their current value
+            void minimize()
+            {
+                _held = _x;
+                for (int i = 0; i < N; i++)
+                    if (_bound(i) == FREE)
+                        _held(i) = 0.0;
+
+                _rhs.noalias() = -_H * _held;
+                _rhs -= _g;
+
+                _K = _H;
+                for (int i = 0; i < N; i++)
+                    if (_bound(i) != FREE) {
+                        _K.row(i).setZero();
+                        _K.col(i).setZero();
+                        _K(i, i) = 1.0;
+                        _rhs(i) = _x(i);
+                    }
+
+                _factor.compute(_K);
+                _target = _factor.solve(_rhs);
+                _factorizations++;
+            }
+
+            // problem
+            Hessian _H;
+            Vector _g, _l, _u;
+
+            // settings
+            size_t _max_iterations;
+            bool _warm;
+
+            // workspace
+            Hessian _K;
+            Eigen::LLT<Hessian> _factor;
+            Vector _x, _held, _rhs, _target, _gradient;
+            Eigen::Matrix<int8_t, N, 1> _bound;
+
+            size_t _iterations;
+            uint64_t _factorizations;
+        };
+    } // namespace optimization
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_OPTIMIZATION_BOXPROGRAM_HPP
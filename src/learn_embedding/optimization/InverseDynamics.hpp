@@ -0,0 +1,371 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_OPTIMIZATION_INVERSEDYNAMICS_HPP
+#define LEARNEMBEDDING_OPTIMIZATION_INVERSEDYNAMICS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/model/FrankaWorkspace.hpp"
+#include "learn_embedding/optimization/QuadraticProgram.hpp"
+
+namespace learn_embedding {
+    namespace optimization {
+        /*
+            Inverse dynamics QP of the ID controllers, over x = (ddq, tau, slack):
+
+                min 1/2 |ddq - ddq_ref|_Q^2 + 1/2 |tau - tau_ref|_R^2 + 1/2 |slack|_S^2
+                s.t. M ddq + h = tau                        (modelConstraint)
+                     J ddq + dJ dq = a_task + slack         (inverseDynamics)
+                     joint position, velocity and acceleration limits on ddq over one time step
+                     effort limits on tau
+
+            Same chained setup as control_lib's QuadraticControl (nP = nC = Dofs, nS = 6,
+            oD = 2). References and task are copied into fixed-size members, so the caller
+            sets them again every tick they change. Model terms come from the FrankaWorkspace
+            cache and the QuadraticProgram keeps its workspace and iterates across ticks.
+
+            The structure of the problem (costs, which constraints, constant blocks and
+            bounds) is written once, on the first solve after a setup change; every tick then
+            overwrites only the blocks that depend on (q, dq): M, J, the right-hand sides of
+            model and task rows and the joint bounds.
+
+            With a budget, a solve that stops short returns its best iterate when the
+            constraint violation stays within the fallback tolerance, otherwise the previous
+            output or the safe one (ddq = 0, tau = gravity, i.e. gravity compensation).
+        */
+        template <int Dofs = 7>
+        class InverseDynamics {
+        public:
+            static constexpr int N = 2 * Dofs + 6, M = 3 * Dofs + 6;
+
+            using Model = model::FrankaWorkspace<Dofs>;
+            using Configuration = typename Model::Configuration;
+            using Program = QuadraticProgram<N, M>;
+            using Solution = typename Program::Vector;
+
+            InverseDynamics()
+                : _status(Program::SOLVED), _fallback(Fallback::SAFE), _tolerance(1e-3), _fallbacks(0), _dt(1e-2), _model_constraint(false), _task_constraint(false), _position(false), _velocity(false), _acceleration(false), _effort(false), _structured(false)
+            {
+                _output.setZero();
+                _state_reference.setZero();
+                _input_reference.setZero();
+                _task.setZero();
+                _Q.setIdentity();
+                _R.setZero();
+                _S.setIdentity();
+
+                // Panda datasheet
+                if constexpr (Dofs == 7)
+                    _acceleration_limit << 15.0, 7.5, 10.0, 12.5, 15.0, 20.0, 20.0;
+                else
+                    _acceleration_limit.setConstant(10.0);
+            }
+
+            InverseDynamics& setModel(const std::shared_ptr<Model>& model)
+            {
+                _model = model;
+                _structured = false;
+                return *this;
+            }
+
+            // Horizon over which position and velocity limits bound the acceleration
+            InverseDynamics& setTimeStep(const double& dt)
+            {
+                _dt = dt;
+                return *this;
+            }
+
+            template <typename Derived>
+            InverseDynamics& stateCost(const Eigen::MatrixBase<Derived>& Q)
+            {
+                _Q = Q;
+                _structured = false;
+                return *this;
+            }
+
+            template <typename Derived>
+            InverseDynamics& inputCost(const Eigen::MatrixBase<Derived>& R)
+            {
+                _R = R;
+                _structured = false;
+                return *this;
+            }
+
+            template <typename Derived>
+            InverseDynamics& slackCost(const Eigen::MatrixBase<Derived>& S)
+            {
+                _S = S;
+                _structured = false;
+                return *this;
+            }
+
+            // Acceleration reference (copied, set it every tick)
+            template <typename Derived>
+            InverseDynamics& stateReference(const Eigen::MatrixBase<Derived>& reference)
+            {
+                static_assert(Derived::SizeAtCompileTime == Eigen::Dynamic || Derived::SizeAtCompileTime == Dofs, "Reference size must be Dofs");
+                _state_reference = reference;
+                return *this;
+            }
+
+            // Torque reference (copied, set it every tick)
+            template <typename Derived>
+            InverseDynamics& inputReference(const Eigen::MatrixBase<Derived>& reference)
+            {
+                static_assert(Derived::SizeAtCompileTime == Eigen::Dynamic || Derived::SizeAtCompileTime == Dofs, "Reference size must be Dofs");
+                _input_reference = reference;
+                return *this;
+            }
+
+            InverseDynamics& modelConstraint()
+            {
+                _model_constraint = true;
+                _structured = false;
+                return *this;
+            }
+
+            // Task space acceleration (6, copied, set it every tick); the first call adds the task rows
+            template <typename Derived>
+            InverseDynamics& inverseDynamics(const Eigen::MatrixBase<Derived>& task)
+            {
+                static_assert(Derived::SizeAtCompileTime == Eigen::Dynamic || Derived::SizeAtCompileTime == 6, "Task size must be 6");
+                _task = task;
+                if (!_task_constraint) {
+                    _task_constraint = true;
+                    _structured = false;
+                }
+                return *this;
+            }
+
+            InverseDynamics& positionLimits()
+            {
+                _position = true;
+                return *this;
+            }
+
+            InverseDynamics& velocityLimits()
+            {
+                _velocity = true;
+                return *this;
+            }
+
+            template <typename Derived>
+            InverseDynamics& accelerationLimits(const Eigen::MatrixBase<Derived>& limit)
+            {
+                _acceleration_limit = limit;
+                return accelerationLimits();
+            }
+
+            InverseDynamics& accelerationLimits()
+            {
+                _acceleration = true;
+                return *this;
+            }
+
+            InverseDynamics& effortLimits()
+            {
+                _effort = true;
+                _structured = false;
+                return *this;
+            }
+
+            // Wall-clock limit of each solve [s], 0 for none
+            InverseDynamics& setBudget(const double& seconds)
+            {
+                _program.setBudget(seconds);
+                return *this;
+            }
+
+            // Command when a solve stops short with a constraint violation above tolerance
+            InverseDynamics& setFallback(const Fallback& fallback, const double& tolerance = 1e-3)
+            {
+                _fallback = fallback;
+                _tolerance = tolerance;
+                return *this;
+            }
+
+            // Solve once at the initial state so the first control tick starts warm
+            template <typename Q, typename DQ>
+            InverseDynamics& init(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq)
+            {
+                (*this)(q, dq);
+                return *this;
+            }
+
+            // (ddq, tau, slack) at the state (q, dq)
+            template <typename Q, typename DQ>
+            const Solution& operator()(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq)
+            {
+                assemble(q, dq);
+                _status = _program.solve();
+
+                if (_status == Program::SOLVED)
+                    _output = _program.solution();
+                else if (_program.residual() <= _tolerance)
+                    _output = _program.best();
+                else {
+                    _fallbacks++;
+                    if (_fallback == Fallback::SAFE) {
+                        _output.setZero();
+                        _output.template segment<Dofs>(Dofs) = _model->gravityVector(q);
+                    }
+                }
+
+                return _output;
+            }
+
+            const typename Program::Status& status() const { return _status; }
+
+            // Solves answered with the fallback command
+            const uint64_t& fallbacks() const { return _fallbacks; }
+
+            // Iterations of the last solve
+            const size_t& iterations() const { return _program.iterations(); }
+
+            // Bounds active in the last solution
+            size_t active() const { return _program.active(); }
+
+            Program& program() { return _program; }
+
+        protected:
+            // Constant part of the problem: costs, identity blocks, effort bounds
+            void structure()
+            {
+                auto& P = _program.hessian();
+                P.setZero();
+                P.template block<Dofs, Dofs>(0, 0) = _Q;
+                P.template block<Dofs, Dofs>(Dofs, Dofs) = _R;
+                P.template block<6, 6>(2 * Dofs, 2 * Dofs) = _S;
+                _program.gradient().setZero();
+
+                auto& A = _program.constraints();
+                auto& l = _program.lower();
+                auto& u = _program.upper();
+                A.setZero();
+                l.setConstant(-INFINITY);
+                u.setConstant(INFINITY);
+
+                if (_model_constraint)
+                    A.template block<Dofs, Dofs>(0, Dofs) = -Eigen::Matrix<double, Dofs, Dofs>::Identity();
+
+                if (_task_constraint)
+                    A.template block<6, 6>(Dofs, 2 * Dofs) = -Eigen::Matrix<double, 6, 6>::Identity();
+
+                // joint bounds on ddq and tau
+                A.template block<2 * Dofs, 2 * Dofs>(Dofs + 6, 0).setIdentity();
+
+                if (_effort) {
+                    const pinocchio::Model& pin = _model->description()->model();
+                    l.template segment<Dofs>(2 * Dofs + 6) = -pin.effortLimit.template head<Dofs>();
+                    u.template segment<Dofs>(2 * Dofs + 6) = pin.effortLimit.template head<Dofs>();
+                }
+
+                _program.modified();
+                _structured = true;
+            }
+
+            // Blocks that depend on the state
+            template <typename Q, typename DQ>
+            void assemble(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq)
+            {
+                if (!_structured)
+                    structure();
+
+                const pinocchio::Model& pin = _model->description()->model();
+
+                // cost
+                auto& g = _program.gradient();
+                g.template head<Dofs>().noalias() = -_Q * _state_reference;
+                g.template segment<Dofs>(Dofs).noalias() = -_R * _input_reference;
+
+                // constraints
+                auto& A = _program.constraints();
+                auto& l = _program.lower();
+                auto& u = _program.upper();
+
+                if (_model_constraint) {
+                    A.template block<Dofs, Dofs>(0, 0) = _model->inertiaMatrix(q);
+                    l.template head<Dofs>() = -_model->nonLinearEffects(q, dq);
+                    u.template head<Dofs>() = l.template head<Dofs>();
+                }
+
+                if (_task_constraint) {
+                    A.template block<6, Dofs>(Dofs, 0) = _model->jacobian(q);
+                    l.template segment<6>(Dofs) = _task - _model->jacobianDerivative(q, dq) * dq;
+                    u.template segment<6>(Dofs) = l.template segment<6>(Dofs);
+                }
+
+                // joint bounds on ddq
+                auto lower = l.template segment<Dofs>(Dofs + 6), upper = u.template segment<Dofs>(Dofs + 6);
+                lower.setConstant(-INFINITY);
+                upper.setConstant(INFINITY);
+                if (_acceleration) {
+                    lower = -_acceleration_limit;
+                    upper = _acceleration_limit;
+                }
+                if (_velocity) {
+                    lower = lower.cwiseMax((-pin.velocityLimit.template head<Dofs>() - dq) / _dt);
+                    upper = upper.cwiseMin((pin.velocityLimit.template head<Dofs>() - dq) / _dt);
+                }
+                if (_position) {
+                    lower = lower.cwiseMax(2.0 * (pin.lowerPositionLimit.template head<Dofs>() - q - dq * _dt) / (_dt * _dt));
+                    upper = upper.cwiseMin(2.0 * (pin.upperPositionLimit.template head<Dofs>() - q - dq * _dt) / (_dt * _dt));
+                }
+                // conflicting limits (e.g. already past one): keep the box non-empty
+                upper = upper.cwiseMax(lower);
+
+                // hessian is constant, only M and J move
+                if (_model_constraint || _task_constraint)
+                    _program.modified();
+            }
+
+            std::shared_ptr<Model> _model;
+            Program _program;
+            typename Program::Status _status;
+
+            Solution _output;
+            Fallback _fallback;
+            double _tolerance;
+            uint64_t _fallbacks;
+
+            double _dt;
+            Eigen::Matrix<double, Dofs, Dofs> _Q, _R;
+            Eigen::Matrix<double, 6, 6> _S;
+            Configuration _state_reference, _input_reference;
+            Eigen::Matrix<double, 6, 1> _task;
+
+            bool _model_constraint, _task_constraint, _position, _velocity, _acceleration, _effort;
+            // structure written into the program
+            bool _structured;
+            Configuration _acceleration_limit;
+        };
+    } // namespace optimization
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_OPTIMIZATION_INVERSEDYNAMICS_HPP
@@ -0,0 +1,338 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_OPTIMIZATION_INVERSEKINEMATICS_HPP
+#define LEARNEMBEDDING_OPTIMIZATION_INVERSEKINEMATICS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/model/FrankaWorkspace.hpp"
+#include "learn_embedding/optimization/BoxProgram.hpp"
+#include "learn_embedding/optimization/QuadraticProgram.hpp"
+
+namespace learn_embedding {
+    namespace optimization {
+        /*
+            Velocity inverse kinematics QP of the IK controllers, over x = (dq, slack):
+
+                min 1/2 |dq - dq_ref|_Q^2 + 1/2 |slack|_S^2
+                s.t. J dq = v_task + slack                  (inverseKinematics)
+                     joint position limits over one time step and velocity limits on dq
+
+            Same chained setup as control_lib's QuadraticControl (nP = Dofs, nC = 0, nS = 6,
+            oD = 1); see InverseDynamics for how references, model and solver state are kept,
+            for the incremental assembly and for the budget. The safe fallback here is dq = 0, holding the configuration.
+
+            Condensed (setCondensed), the slack is eliminated, slack = J dq - v_task, which
+            leaves the damped least squares
+
+                min 1/2 dq^T (Q + J^T S J) dq - (Q dq_ref + J^T S v_task)^T dq    s.t.    l <= dq <= u
+
+            over the joint velocities alone, solved exactly by the active-set BoxProgram
+            instead of the ADMM. The solution is the same; every iterate is feasible, so the
+            budget and fallback settings only apply to the generic path.
+        */
+        template <int Dofs = 7>
+        class InverseKinematics {
+        public:
+            static constexpr int N = Dofs + 6, M = Dofs + 6;
+
+            using Model = model::FrankaWorkspace<Dofs>;
+            using Configuration = typename Model::Configuration;
+            using Program = QuadraticProgram<N, M>;
+            using Box = BoxProgram<Dofs>;
+            using Solution = typename Program::Vector;
+
+            InverseKinematics()
+                : _status(Program::SOLVED), _fallback(Fallback::SAFE), _tolerance(1e-3), _fallbacks(0), _condensed(false), _dt(1e-2), _task_constraint(false),
+                  _position(false), _velocity(false), _structured(false)
+            {
+                _output.setZero();
+                _state_reference.setZero();
+                _task.setZero();
+                _Q.setIdentity();
+                _S.setIdentity();
+            }
+
+            InverseKinematics& setModel(const std::shared_ptr<Model>& model)
+            {
+                _model = model;
+                _structured = false;
+                return *this;
+            }
+
+            // Horizon over which position limits bound the velocity
+            InverseKinematics& setTimeStep(const double& dt)
+            {
+                _dt = dt;
+                return *this;
+            }
+
+            template <typename Derived>
+            InverseKinematics& stateCost(const Eigen::MatrixBase<Derived>& Q)
+            {
+                _Q = Q;
+                _structured = false;
+                return *this;
+            }
+
+            template <typename Derived>
+            InverseKinematics& slackCost(const Eigen::MatrixBase<Derived>& S)
+            {
+                _S = S;
+                _structured = false;
+                return *this;
+            }
+
+            // Joint velocity reference (copied, set it every tick)
+            template <typename Derived>
+            InverseKinematics& stateReference(const Eigen::MatrixBase<Derived>& reference)
+            {
+                static_assert(Derived::SizeAtCompileTime == Eigen::Dynamic || Derived::SizeAtCompileTime == Dofs, "Reference size must be Dofs");
+                _state_reference = reference;
+                return *this;
+            }
+
+            // Task space velocity (6, copied, set it every tick); the first call adds the task rows
+            template <typename Derived>
+            InverseKinematics& inverseKinematics(const Eigen::MatrixBase<Derived>& task)
+            {
+                static_assert(Derived::SizeAtCompileTime == Eigen::Dynamic || Derived::SizeAtCompileTime == 6, "Task size must be 6");
+                _task = task;
+                if (!_task_constraint) {
+                    _task_constraint = true;
+                    _structured = false;
+                }
+                return *this;
+            }
+
+            InverseKinematics& positionLimits()
+            {
+                _position = true;
+                return *this;
+            }
+
+            InverseKinematics& velocityLimits()
+            {
+                _velocity = true;
+                return *this;
+            }
+
+            // Wall-clock limit of each solve [s], 0 for none
+            InverseKinematics& setBudget(const double& seconds)
+            {
+                _program.setBudget(seconds);
+                return *this;
+            }
+
+            // Command when a solve stops short with a constraint violation above tolerance
+            InverseKinematics& setFallback(const Fallback& fallback, const double& tolerance = 1e-3)
+            {
+                _fallback = fallback;
+                _tolerance = tolerance;
+                return *this;
+            }
+
+            // Solve the slack-free box QP by active set instead of the full QP by ADMM
+            InverseKinematics& setCondensed(const bool& condensed)
+            {
+                _condensed = condensed;
+                return *this;
+            }
+
+            // Solve once at the initial configuration so the first control tick starts warm
+            template <typename Q>
+            InverseKinematics& init(const Eigen::MatrixBase<Q>& q)
+            {
+                (*this)(q);
+                return *this;
+            }
+
+            // (dq, slack) at the configuration q
+            template <typename Q>
+            const Solution& operator()(const Eigen::MatrixBase<Q>& q)
+            {
+                if (_condensed) {
+                    condense(q);
+                    _status = _box.solve() == Box::SOLVED ? Program::SOLVED : Program::MAX_ITERATIONS;
+
+                    _output.template head<Dofs>() = _box.solution();
+                    if (_task_constraint)
+                        _output.template tail<6>().noalias() = _model->jacobian(q) * _box.solution() - _task;
+                    else
+                        _output.template tail<6>().setZero();
+
+                    return _output;
+                }
+
+                assemble(q);
+                _status = _program.solve();
+
+                if (_status == Program::SOLVED)
+                    _output = _program.solution();
+                else if (_program.residual() <= _tolerance)
+                    _output = _program.best();
+                else {
+                    _fallbacks++;
+                    if (_fallback == Fallback::SAFE)
+                        _output.setZero();
+                }
+
+                return _output;
+            }
+
+            const typename Program::Status& status() const { return _status; }
+
+            // Solves answered with the fallback command
+            const uint64_t& fallbacks() const { return _fallbacks; }
+
+            // Iterations of the last solve, ADMM or active set
+            const size_t& iterations() const { return _condensed ? _box.iterations() : _program.iterations(); }
+
+            // Bounds active in the last solution
+            size_t active() const { return _condensed ? _box.active() : _program.active(); }
+
+            Program& program() { return _program; }
+
+            Box& box() { return _box; }
+
+        protected:
+            // Constant part of the problem: costs, identity blocks
+            void structure()
+            {
+                auto& P = _program.hessian();
+                P.setZero();
+                P.template block<Dofs, Dofs>(0, 0) = _Q;
+                P.template block<6, 6>(Dofs, Dofs) = _S;
+                _program.gradient().setZero();
+
+                auto& A = _program.constraints();
+                A.setZero();
+                _program.lower().setConstant(-INFINITY);
+                _program.upper().setConstant(INFINITY);
+
+                if (_task_constraint)
+                    A.template block<6, 6>(0, Dofs) = -Eigen::Matrix<double, 6, 6>::Identity();
+
+                // joint bounds on dq
+                A.template block<Dofs, Dofs>(6, 0).setIdentity();
+
+                _program.modified();
+                _structured = true;
+            }
+
+            // Blocks that depend on the configuration
+            template <typename Q>
+            void assemble(const Eigen::MatrixBase<Q>& q)
+            {
+                if (!_structured)
+                    structure();
+
+                _program.gradient().template head<Dofs>().noalias() = -_Q * _state_reference;
+
+                auto& l = _program.lower();
+                auto& u = _program.upper();
+
+                if (_task_constraint) {
+                    _program.constraints().template block<6, Dofs>(0, 0) = _model->jacobian(q);
+                    l.template head<6>() = _task;
+                    u.template head<6>() = l.template head<6>();
+                    _program.modified();
+                }
+
+                limits(q);
+                l.template segment<Dofs>(6) = _lower;
+                u.template segment<Dofs>(6) = _upper;
+            }
+
+            template <typename Q>
+            void condense(const Eigen::MatrixBase<Q>& q)
+            {
+                auto& H = _box.hessian();
+                auto& g = _box.gradient();
+                H = _Q;
+                g.noalias() = -_Q * _state_reference;
+
+                if (_task_constraint) {
+                    const typename Model::Jacobian& J = _model->jacobian(q);
+                    _SJ.noalias() = _S * J;
+                    H.noalias() += J.transpose() * _SJ;
+                    g.noalias() -= _SJ.transpose() * _task;
+                }
+
+                limits(q);
+                _box.lower() = _lower;
+                _box.upper() = _upper;
+            }
+
+            // Joint velocity bounds at q: velocity limits and position limits over one time step
+            template <typename Q>
+            void limits(const Eigen::MatrixBase<Q>& q)
+            {
+                const pinocchio::Model& pin = _model->description()->model();
+
+                _lower.setConstant(-INFINITY);
+                _upper.setConstant(INFINITY);
+                if (_velocity) {
+                    _lower = -pin.velocityLimit.template head<Dofs>();
+                    _upper = pin.velocityLimit.template head<Dofs>();
+                }
+                if (_position) {
+                    _lower = _lower.cwiseMax((pin.lowerPositionLimit.template head<Dofs>() - q) / _dt);
+                    _upper = _upper.cwiseMin((pin.upperPositionLimit.template head<Dofs>() - q) / _dt);
+                }
+                _upper = _upper.cwiseMax(_lower);
+            }
+
+            std::shared_ptr<Model> _model;
+            Program _program;
+            Box _box;
+            typename Program::Status _status;
+
+            Solution _output;
+            Fallback _fallback;
+            double _tolerance;
+            uint64_t _fallbacks;
+            bool _condensed;
+
+            double _dt;
+            Eigen::Matrix<double, Dofs, Dofs> _Q;
+            Eigen::Matrix<double, 6, 6> _S;
+            Eigen::Matrix<double, 6, Dofs> _SJ;
+            Configuration _lower, _upper;
+            Configuration _state_reference;
+            Eigen::Matrix<double, 6, 1> _task;
+
+            bool _task_constraint, _position, _velocity;
+            // structure written into the program
+            bool _structured;
+        };
+    } // namespace optimization
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_OPTIMIZATION_INVERSEKINEMATICS_HPP
@@ -0,0 +1,294 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_OPTIMIZATION_QUADRATICPROGRAM_HPP
+#define LEARNEMBEDDING_OPTIMIZATION_QUADRATICPROGRAM_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+
+namespace learn_embedding {
+    namespace optimization {
+        // Command of a controller QP that stopped short: the previous one or a safe one (see InverseDynamics, InverseKinematics)
+        enum class Fallback {
+            PREVIOUS,
+            SAFE
+        };
+
+        /*
+            Dense convex QP with a persistent workspace,
+
+                min 1/2 x^T P x + g^T x    s.t.    l <= A x <= u,
+
+            solved by ADMM as in OSQP: every iteration is one solve with the factor of
+            P + sigma I + A^T diag(rho) A, a projection on [l, u] and a dual update. Equality
+            rows (l = u) get a stiffer rho. rho adapts to the residual balance during the solve.
+
+            The problem data are written in place through the accessors; modified() marks the
+            matrices as changed so the factor is rebuilt once before the next solve, while
+            gradient and bounds can change freely. With warm start (default) the primal and
+            dual iterates and rho carry over from one solve to the next, so a sequence of
+            slowly changing problems (one per control tick) converges in a few iterations.
+            Sizes are fixed at compile time; solve() never allocates.
+
+            A solve can be bounded in iterations and wall-clock time. When it stops short
+            of convergence, best() is the iterate with the smallest primal residual seen at
+            the residual checks, for the caller to accept or replace with a safe command.
+        */
+        template <int N, int M>
+        class QuadraticProgram {
+        public:
+            using Vector = Eigen::Matrix<double, N, 1>;
+            using Hessian = Eigen::Matrix<double, N, N>;
+            using Constraints = Eigen::Matrix<double, M, N>;
+            using Bounds = Eigen::Matrix<double, M, 1>;
+
+            enum Status {
+                SOLVED,
+                MAX_ITERATIONS,
+                BUDGET
+            };
+
+            QuadraticProgram()
+                : _sigma(1e-6), _alpha(1.6), _rho(0.1), _abs(1e-5), _rel(1e-5), _max_iterations(4000), _check(10), _budget(0), _warm(true), _modified(true),
+                  _iterations(0), _factorizations(0), _residual(INFINITY), _budget_hits(0)
+            {
+                _P.setZero();
+                _g.setZero();
+                _A.setZero();
+                _l.setConstant(-INFINITY);
+                _u.setConstant(INFINITY);
+                reset();
+            }
+
+            // Problem data; call modified() after changing hessian() or constraints()
+            Hessian& hessian() { return _P; }
+
+            Vector& gradient() { return _g; }
+
+            Constraints& constraints() { return _A; }
+
+            Bounds& lower() { return _l; }
+
+            Bounds& upper() { return _u; }
+
+            QuadraticProgram& modified()
+            {
+                _modified = true;
+                return *this;
+            }
+
+            // Keep iterates and rho between solves
+            QuadraticProgram& setWarmStart(const bool& warm)
+            {
+                _warm = warm;
+                return *this;
+            }
+
+            QuadraticProgram& setTolerance(const double& absolute, const double& relative)
+            {
+                _abs = absolute;
+                _rel = relative;
+                return *this;
+            }
+
+            QuadraticProgram& setMaxIterations(const size_t& iterations)
+            {
+                _max_iterations = iterations;
+                return *this;
+            }
+
+            // Wall-clock limit of the iterations of one solve [s], checked with the residuals; 0 disables it
+            QuadraticProgram& setBudget(const double& seconds)
+            {
+                _budget = std::chrono::nanoseconds(static_cast<int64_t>(1e9 * seconds));
+                return *this;
+            }
+
+            // Forget the previous solution
+            void reset()
+            {
+                _x.setZero();
+                _best.setZero();
+                _z.setZero();
+                _y.setZero();
+                _rho = 0.1;
+                _rhos.setConstant(_rho);
+                _modified = true;
+            }
+
+            Status solve()
+            {
+                if (!_warm)
+                    reset();
+
+                // equality rows may have changed with the bounds
+                for (int i = 0; i < M; i++) {
+                    double rho = (_u(i) - _l(i) < 1e-9) ? 1e3 * _rho : _rho;
+                    if (rho != _rhos(i)) {
+                        _rhos(i) = rho;
+                        _modified = true;
+                    }
+                }
+
+                if (_modified)
+                    factorize();
+
+                Status status = MAX_ITERATIONS;
+                _residual = INFINITY;
+                auto start = std::chrono::steady_clock::now();
+
+                for (_iterations = 1; _iterations <= _max_iterations; _iterations++) {
+                    _rhs.noalias() = _sigma * _x - _g;
+                    _rhs.noalias() += _A.transpose() * (_rhos.cwiseProduct(_z) - _y);
+                    _factor.solveInPlace(_rhs);
+
+                    _Ax.noalias() = _A * _rhs;
+                    _x = _alpha * _rhs + (1.0 - _alpha) * _x;
+                    _Ax = _alpha * _Ax + (1.0 - _alpha) * _z;
+
+                    _z = (_Ax + _y.cwiseQuotient(_rhos)).cwiseMax(_l).cwiseMin(_u);
+                    _y += _rhos.cwiseProduct(_Ax - _z);
+
+                    if (_iterations % _check == 0 || _iterations == _max_iterations) {
+                        if (converged()) {
+                            status = SOLVED;
+                            break;
+                        }
+                        if (_budget.count() && std::chrono::steady_clock::now() - start > _budget) {
+                            status = BUDGET;
+                            break;
+                        }
+                    }
+                }
+                _iterations = std::min(_iterations, _max_iterations);
+
+                if (status != SOLVED)
+                    _budget_hits++;
+
+                return status;
+            }
+
+            const Vector& solution() const { return _x; }
+
+            // Checked iterate of the last solve with the smallest primal residual, and that residual
+            const Vector& best() const { return _best; }
+
+            const double& residual() const { return _residual; }
+
+            // Solves stopped by the iteration or time budget
+            const uint64_t& budgetHits() const { return _budget_hits; }
+
+            // Dual variables of the constraint rows
+            const Bounds& dual() const { return _y; }
+
+            // Iterations of the last solve
+            const size_t& iterations() const { return _iterations; }
+
+            // Factorizations so far (matrix changes and rho updates)
+            const uint64_t& factorizations() const { return _factorizations; }
+
+            // Inequality rows at one of their bounds in the last solution
+            size_t active(const double& tolerance = 1e-6) const
+            {
+                size_t count = 0;
+                for (int i = 0; i < M; i++)
+                    if (_u(i) - _l(i) >= 1e-9 && (_z(i) - _l(i) < tolerance || _u(i) - _z(i) < tolerance))
+                        count++;
+                return count;
+            }
+
+        protected:
+            void factorize()
+            {
+                _K = _P;
+                _K.diagonal().array() += _sigma;
+                _K.noalias() += _A.transpose() * _rhos.asDiagonal() * _A;
+                _factor.compute(_K);
+                _modified = false;
+                _factorizations++;
+            }
+
+            // Residuals against the OSQP criteria; also rebalances rho
+            bool converged()
+            {
+                _Ax.noalias() = _A * _x;
+                _Px.noalias() = _P * _x;
+                _Aty.noalias() = _A.transpose() * _y;
+
+                double primal = (_Ax - _z).cwiseAbs().maxCoeff(), dual = (_Px + _g + _Aty).cwiseAbs().maxCoeff(),
+                       primal_scale = std::max(_Ax.cwiseAbs().maxCoeff(), _z.cwiseAbs().maxCoeff()),
+                       dual_scale = std::max({_Px.cwiseAbs().maxCoeff(), _Aty.cwiseAbs().maxCoeff(), _g.cwiseAbs().maxCoeff()});
+
+                if (primal < _residual) {
+                    _residual = primal;
+                    _best = _x;
+                }
+
+                if (primal <= _abs + _rel * primal_scale && dual <= _abs + _rel * dual_scale)
+                    return true;
+
+                double rho = _rho * std::sqrt((primal / (primal_scale + 1e-10)) / (dual / (dual_scale + 1e-10) + 1e-10));
+                rho = std::min(std::max(rho, 1e-6), 1e6);
+                if (rho > 5.0 * _rho || rho < 0.2 * _rho) {
+                    _rhos *= rho / _rho;
+                    _rho = rho;
+                    factorize();
+                }
+
+                return false;
+            }
+
+            // problem
+            Hessian _P;
+            Vector _g;
+            Constraints _A;
+            Bounds _l, _u;
+
+            // settings
+            double _sigma, _alpha, _rho, _abs, _rel;
+            size_t _max_iterations, _check;
+            std::chrono::nanoseconds _budget;
+            bool _warm, _modified;
+
+            // workspace
+            Hessian _K;
+            Eigen::LLT<Hessian> _factor;
+            Vector _x, _rhs, _Px, _Aty, _best;
+            Bounds _z, _y, _Ax, _rhos;
+
+            size_t _iterations;
+            uint64_t _factorizations;
+            double _residual;
+            uint64_t _budget_hits;
+        };
+    } // namespace optimization
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_OPTIMIZATION_QUADRATICPROGRAM_HPP
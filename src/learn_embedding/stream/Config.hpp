@@ -0,0 +1,167 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_STREAM_CONFIG_HPP
+#define LEARNEMBEDDING_STREAM_CONFIG_HPP
+
+#include <iostream>
+#include <string>
+
+#include <yaml-cpp/yaml.h>
+
+namespace learn_embedding {
+    namespace stream {
+        enum class Transport {
+            ZMQ, // blocking request to the model server
+            ASYNC, // non-blocking, requests issued by an I/O thread
+            SHM, // blocking request through shared memory (same host)
+            NATIVE, // in-process evaluation, no model server
+            GRID // interpolation of the precomputed first order ds (src/tools/ds_grid)
+        };
+
+        // Answer to a query that missed its latency budget
+        enum class Fallback {
+            LOCAL, // use the local linear ds
+            EXTRAPOLATE // extrapolate the last two replies, then local
+        };
+
+        /*
+            How TaskDynamics reaches the learned ds.
+            Read from the optional "stream" section of dynamics_params.yaml, e.g.
+
+            stream:
+              transport: shm # zmq, async, shm, native, grid
+              shm: ds_stream
+              grid: rsc/demos/demo_2/models/first_order.grid
+              budget: 0.0005 # [s], 0 disables the deadline
+              fallback: local # local, extrapolate
+              horizon: 10 # states evaluated per request
+              step: 0.001 # [s] spacing of the predicted states (controller period)
+              telemetry: latency.csv # periodic export of the latency histograms
+              period: 1.0 # [s] export period
+        */
+        struct Config {
+            Config(const Transport& default_transport = Transport::ZMQ) : transport(default_transport), shm("ds_stream"), budget(0), fallback(Fallback::LOCAL), horizon(1), step(1.0e-3), period(1.0) {}
+
+            Config(const std::string& demo_path, const YAML::Node& node, const Transport& default_transport = Transport::ZMQ) : Config(default_transport)
+            {
+                demo = demo_path;
+                grid = demo_path + "/models/first_order.grid";
+
+                if (node && node["transport"])
+                    setTransport(node["transport"].as<std::string>());
+
+                if (node && node["shm"])
+                    shm = node["shm"].as<std::string>();
+
+                if (node && node["grid"])
+                    grid = node["grid"].as<std::string>();
+
+                if (node && node["budget"])
+                    budget = node["budget"].as<double>();
+
+                if (node && node["fallback"])
+                    setFallback(node["fallback"].as<std::string>());
+
+                if (node && node["horizon"])
+                    horizon = node["horizon"].as<size_t>();
+
+                if (node && node["step"])
+                    setStep(node["step"].as<double>());
+
+                if (node && node["telemetry"])
+                    telemetry = node["telemetry"].as<std::string>();
+
+                if (node && node["period"])
+                    period = node["period"].as<double>();
+            }
+
+            Config& setTransport(const std::string& name)
+            {
+                if (name == "zmq")
+                    transport = Transport::ZMQ;
+                else if (name == "async")
+                    transport = Transport::ASYNC;
+                else if (name == "shm")
+                    transport = Transport::SHM;
+                else if (name == "native")
+                    transport = Transport::NATIVE;
+                else if (name == "grid")
+                    transport = Transport::GRID;
+                else
+                    std::cerr << "Unknown transport " << name << std::endl;
+
+                return *this;
+            }
+
+            // Spacing of the predicted states, at least 1 ns (the stream keeps it in integer nanoseconds)
+            Config& setStep(const double& value)
+            {
+                if (value >= 1e-9)
+                    step = value;
+                else
+                    std::cerr << "Invalid step " << value << ", keeping " << step << " s" << std::endl;
+
+                return *this;
+            }
+
+            Config& setFallback(const std::string& name)
+            {
+                if (name == "local")
+                    fallback = Fallback::LOCAL;
+                else if (name == "extrapolate")
+                    fallback = Fallback::EXTRAPOLATE;
+                else
+                    std::cerr << "Unknown fallback " << name << std::endl;
+
+                return *this;
+            }
+
+            Transport transport;
+
+            // shared memory segment name (in /dev/shm)
+            std::string shm;
+
+            // demo folder holding the model for the native transport
+            std::string demo;
+
+            // sampled ds for the grid transport
+            std::string grid;
+
+            // latency budget of a query [s]
+            double budget;
+            Fallback fallback;
+
+            // states per request and their spacing [s]
+            size_t horizon;
+            double step;
+
+            // csv file for the latency histograms (empty disables the export) and export period [s]
+            std::string telemetry;
+            double period;
+        };
+    } // namespace stream
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_STREAM_CONFIG_HPP
@@ -0,0 +1,248 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_STREAM_DYNAMICSSERVER_HPP
+#define LEARNEMBEDDING_STREAM_DYNAMICSSERVER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <zmq.hpp>
+#include <zmq_addon.hpp>
+
+#include "learn_embedding/dynamics/AbstractDynamics.hpp"
+#include "learn_embedding/stream/Message.hpp"
+#include "learn_embedding/tools/Histogram.hpp"
+#include "learn_embedding/tools/SpscRing.hpp"
+
+namespace learn_embedding {
+    namespace stream {
+        /*
+            zmq server of a ds for any number of WireRequester clients (zmq and async transports).
+
+            The first request opens a window; every request arriving before it closes (or
+            until the batch is full) is stacked column-wise, possibly several states per
+            request (horizon), evaluated with a single AbstractDynamics::batch call and
+            routed back to its client. Each reply reports how long its request waited for
+            the batch and how long the evaluation took. Requests that cannot be served
+            (malformed, or too large for a reply) get an empty reply (dim 0) on their
+            envelope, so that their client fails at once instead of waiting for a timeout.
+
+            For latency-tolerance tests the server can hold every reply for a fixed latency
+            plus a random jitter and never answer a fraction of the requests; the random
+            sequence is seeded, so runs are reproducible.
+        */
+        template <int In, int Out>
+        class DynamicsServer {
+        public:
+            DynamicsServer() : _context(1), _socket(_context, zmq::socket_type::router), _window(200000), _latency(0), _jitter(0), _drop(0), _requests(0), _batches(0), _dropped(0), _rejected(0) {}
+
+            // Bind tcp://*:port; window [s] to gather requests, capacity in requests per batch
+            DynamicsServer& configure(const std::string& port, const double& window = 2.0e-4, const size_t& capacity = 64)
+            {
+                _socket.set(zmq::sockopt::linger, 0);
+                _socket.bind("tcp://*:" + port);
+
+                _window = static_cast<int64_t>(1e9 * window);
+                _pending.resize(std::max<size_t>(capacity, 1));
+                _order.resize(_pending.size());
+
+                return *this;
+            }
+
+            // Reply latency and uniform jitter [s], fraction of requests left unanswered
+            DynamicsServer& setFaults(const double& latency, const double& jitter, const double& drop, const uint64_t& seed = 0)
+            {
+                _latency = static_cast<int64_t>(1e9 * latency);
+                _jitter = static_cast<int64_t>(1e9 * jitter);
+                _drop = drop;
+                _random.seed(seed);
+
+                return *this;
+            }
+
+            // Gather and serve one batch; false if nothing arrived within timeout [ms]
+            bool serve(dynamics::AbstractDynamics<In, Out>& ds, const int& timeout = 100)
+            {
+                zmq::pollitem_t items[] = {{_socket.handle(), 0, ZMQ_POLLIN, 0}};
+                if (zmq::poll(items, 1, std::chrono::milliseconds(timeout)) <= 0)
+                    return false;
+
+                size_t count = 0;
+                Eigen::Index states = 0;
+                int64_t deadline = now() + _window;
+                tools::Spinner spinner;
+
+                for (bool first = true; count < _pending.size() && (first || now() < deadline); first = false) {
+                    Pending& request = _pending[count];
+                    request.frames.clear();
+                    if (!zmq::recv_multipart(_socket, std::back_inserter(request.frames), zmq::recv_flags::dontwait)) {
+                        spinner.wait();
+                        continue;
+                    }
+                    request.received = now();
+
+                    // envelope (routing id, delimiter) then the message; without an envelope there is no one to reply to
+                    const zmq::message_t& payload = request.frames.back();
+                    if (request.frames.size() < 2)
+                        continue;
+                    if (payload.size() > sizeof(Message)) {
+                        reject(request);
+                        continue;
+                    }
+                    std::memcpy(&request.message, payload.data(), payload.size());
+                    if (!request.message.decode(payload.size()) || request.message.header.dim % In || request.message.header.dim / In * Out > Message::CAPACITY) {
+                        reject(request);
+                        continue;
+                    }
+
+                    request.column = states;
+                    states += request.message.header.dim / In;
+                    count++;
+                }
+
+                // one evaluation for the whole batch
+                _X.resize(In, states);
+                for (size_t i = 0; i < count; i++)
+                    _X.middleCols(_pending[i].column, _pending[i].message.header.dim / In) = Eigen::Map<const Eigen::Matrix<double, In, Eigen::Dynamic>>(_pending[i].message.payload, In, _pending[i].message.header.dim / In);
+
+                int64_t start = now();
+                ds.batch(_X, _Y);
+                int64_t end = now();
+
+                // replies leave in order of release time
+                for (size_t i = 0; i < count; i++) {
+                    _pending[i].release = _pending[i].received + _latency + (_jitter ? std::uniform_int_distribution<int64_t>(0, _jitter)(_random) : 0);
+                    _pending[i].drop = _drop > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(_random) < _drop;
+                    _order[i] = i;
+                }
+                std::sort(_order.begin(), _order.begin() + count, [&](const size_t& a, const size_t& b) { return _pending[a].release < _pending[b].release; });
+
+                for (size_t k = 0; k < count; k++) {
+                    Pending& request = _pending[_order[k]];
+                    Eigen::Index columns = request.message.header.dim / In;
+
+                    if (request.drop) {
+                        _dropped++;
+                        continue;
+                    }
+
+                    while (now() < request.release)
+                        spinner.wait();
+
+                    request.message.header.dim = columns * Out;
+                    request.message.header.queue = start - request.received;
+                    request.message.header.compute = end - start;
+                    Eigen::Map<Eigen::Matrix<double, Out, Eigen::Dynamic>>(request.message.payload, Out, columns) = _Y.middleCols(request.column, columns);
+
+                    for (size_t j = 0; j < request.frames.size() - 1; j++)
+                        _socket.send(request.frames[j], zmq::send_flags::sndmore);
+                    _socket.send(zmq::const_buffer(&request.message, request.message.size()), zmq::send_flags::none);
+                }
+
+                _requests += count;
+                _batches++;
+                _size.record(states);
+                _compute.record(end - start);
+
+                return true;
+            }
+
+            const size_t& requests() const { return _requests; }
+
+            const size_t& batches() const { return _batches; }
+
+            const size_t& dropped() const { return _dropped; }
+
+            // Requests answered with an empty reply
+            const size_t& rejected() const { return _rejected; }
+
+            void print(std::ostream& os) const
+            {
+                os << "served " << _requests << " requests in " << _batches << " batches (" << _dropped << " dropped, " << _rejected << " rejected)" << std::endl;
+                os << "states per batch: mean " << _size.mean() << " p50 " << _size.percentile(0.5) << " max " << _size.max() << std::endl;
+                _compute.print("batch evaluation", os);
+            }
+
+        protected:
+            struct Pending {
+                std::vector<zmq::message_t> frames;
+                Message message;
+                int64_t received, release;
+                Eigen::Index column;
+                bool drop;
+            };
+
+            static int64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            // Empty reply to a request that cannot be served, echoing its sequence and stamp when readable
+            void reject(Pending& request)
+            {
+                Header header{};
+                const zmq::message_t& payload = request.frames.back();
+                if (payload.size() >= sizeof(Header))
+                    std::memcpy(&header, payload.data(), sizeof(Header));
+                header.dim = 0;
+                header.queue = 0;
+                header.compute = 0;
+
+                for (size_t j = 0; j < request.frames.size() - 1; j++)
+                    _socket.send(request.frames[j], zmq::send_flags::sndmore);
+                _socket.send(zmq::const_buffer(&header, sizeof(Header)), zmq::send_flags::none);
+
+                _rejected++;
+            }
+
+            zmq::context_t _context;
+            zmq::socket_t _socket;
+
+            // batching window [ns] and requests of the current batch
+            int64_t _window;
+            std::vector<Pending> _pending;
+            std::vector<size_t> _order;
+
+            // fault injection
+            int64_t _latency, _jitter;
+            double _drop;
+            std::mt19937_64 _random;
+
+            typename dynamics::AbstractDynamics<In, Out>::Inputs _X;
+            typename dynamics::AbstractDynamics<In, Out>::Outputs _Y;
+
+            size_t _requests, _batches, _dropped, _rejected;
+            tools::Histogram _size, _compute;
+        };
+    } // namespace stream
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_STREAM_DYNAMICSSERVER_HPP
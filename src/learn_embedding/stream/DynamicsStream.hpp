@@ -0,0 +1,614 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_STREAM_DYNAMICSSTREAM_HPP
+#define LEARNEMBEDDING_STREAM_DYNAMICSSTREAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/dynamics/SecondGeometry.hpp"
+#include "learn_embedding/dynamics/VoxelGrid.hpp"
+#include "learn_embedding/stream/Config.hpp"
+#include "learn_embedding/stream/SharedMemory.hpp"
+#include "learn_embedding/stream/WireRequester.hpp"
+#include "learn_embedding/tools/Histogram.hpp"
+#include "learn_embedding/tools/Mailbox.hpp"
+
+namespace learn_embedding {
+    namespace stream {
+        /*
+            Client side of the external ds link.
+
+            - ZMQ: every query is a blocking request to the model server (Message wire format).
+            - ASYNC: a dedicated thread keeps sending the most recent state and publishes
+              each reply through a mailbox, so that query() never blocks and simply returns
+              the freshest reply available.
+            - SHM: blocking request through a shared memory ring, for a server on the same host.
+            - NATIVE: the learned ds is evaluated in-process.
+            - GRID: the first order ds is interpolated from a precomputed grid; outside
+              the sampled box the caller falls back to its local ds.
+
+            With a horizon of N the state is integrated forward N - 1 steps (holding the last
+            reply constant) and the server evaluates all N states in a single request. The
+            replies are then consumed one per query, so requests are issued every N queries;
+            in async mode the reply matching the age of the request is used.
+
+            With a latency budget no query takes longer than the budget: a zmq request is
+            handed to the I/O thread and waited for at most the budget, a shm request gives
+            up at the deadline and an async reply older than the budget (plus the horizon)
+            is discarded. Missed queries are counted, recorded and answered by the fallback policy.
+
+            Every remote request feeds three latency histograms: round trip, server evaluation
+            (reported in the reply) and queueing (state waiting to be sent plus request waiting
+            on the server). They are printed at shutdown and can be exported periodically to a
+            csv file by a separate thread.
+        */
+        template <int In, int Out>
+        class DynamicsStream {
+        public:
+            using Input = Eigen::Matrix<double, In, 1>;
+            using Output = Eigen::Matrix<double, Out, 1>;
+
+            struct Miss {
+                int64_t stamp; // time of the query [ns]
+                double age; // age of the last valid reply [s]
+            };
+
+            DynamicsStream()
+                : _transport(Transport::ZMQ), _budget(0), _fallback(Fallback::LOCAL), _horizon(1), _step(1000000), _cursor(1), _continuous(false), _running(false), _dropped(0), _valid(false), _last(Output::Zero()), _prev(Output::Zero()), _stamp(0), _prev_stamp(0), _queries(0), _misses(0), _exporting(false)
+            {
+                _missed.reserve(MAX_RECORDS);
+                resize();
+            }
+
+            ~DynamicsStream()
+            {
+                stop();
+                setTelemetry("");
+
+                if (_misses)
+                    std::cout << "ds stream: " << _misses << " deadline misses over " << _queries << " queries" << std::endl;
+
+                if (_round_trip.count()) {
+                    _round_trip.print("ds stream round trip", std::cout);
+                    _compute.print("ds stream server compute", std::cout);
+                    _queue.print("ds stream queueing", std::cout);
+                }
+            }
+
+            DynamicsStream& configure(const std::string& host, const std::string& port)
+            {
+                _host = host;
+                _port = port;
+                _requester.configure(_host, _port);
+                return *this;
+            }
+
+            // Select the transport; on failure the blocking zmq request is kept
+            DynamicsStream& configure(const Config& config)
+            {
+                // transport, budget and fallback are settled with the I/O thread down, then update() runs once
+                // (in setHorizon), so no zmq thread is started for a transport that does not use it
+                stop();
+                _budget = static_cast<int64_t>(1e9 * config.budget);
+                _fallback = config.fallback;
+                _transport = Transport::ZMQ;
+                _continuous = false;
+
+                switch (config.transport) {
+                case Transport::ZMQ:
+                    break;
+                case Transport::ASYNC:
+                    _transport = Transport::ASYNC;
+                    _continuous = true;
+                    break;
+                case Transport::SHM:
+                    if (_shm.configure(config.shm))
+                        _transport = Transport::SHM;
+                    break;
+                case Transport::NATIVE:
+                    if ((_native = load(config.demo)))
+                        _transport = Transport::NATIVE;
+                    break;
+                case Transport::GRID:
+                    if ((_native = grid(config.grid, std::integral_constant<bool, In == Out>())))
+                        _transport = Transport::GRID;
+                    break;
+                }
+
+                setHorizon(config.horizon, config.step);
+
+                return setTelemetry(config.telemetry, config.period);
+            }
+
+            DynamicsStream& setAsync(const bool& value)
+            {
+                _transport = value ? Transport::ASYNC : Transport::ZMQ;
+                _continuous = value;
+                return update();
+            }
+
+            DynamicsStream& setNative(const std::shared_ptr<dynamics::AbstractDynamics<In, Out>>& ds)
+            {
+                _native = ds;
+                if (_native)
+                    _transport = Transport::NATIVE;
+                return update();
+            }
+
+            // Latency budget in seconds (0 disables it)
+            DynamicsStream& setBudget(const double& budget, const Fallback& fallback = Fallback::LOCAL)
+            {
+                _budget = static_cast<int64_t>(1e9 * budget);
+                _fallback = fallback;
+                return update();
+            }
+
+            // Number of states per request and their spacing in seconds (the controller period)
+            DynamicsStream& setHorizon(size_t horizon, const double& step)
+            {
+                if (_transport == Transport::SHM && horizon * In > Frame::CAPACITY) {
+                    std::cerr << "Shared memory frames hold at most " << Frame::CAPACITY / In << " states" << std::endl;
+                    horizon = Frame::CAPACITY / In;
+                }
+
+                // mailbox slots are resized while the I/O thread is down
+                stop();
+                _horizon = std::max<size_t>(horizon, 1);
+                // receive() divides by the step and predict() integrates over it
+                if (step >= 1e-9)
+                    _step = std::llround(1e9 * step);
+                else
+                    std::cerr << "Invalid step " << step << ", keeping " << 1e-9 * _step << " s" << std::endl;
+                resize();
+
+                return update();
+            }
+
+            // Append the latency percentiles to a csv file every period seconds (empty path stops)
+            DynamicsStream& setTelemetry(const std::string& path, const double& period = 1.0)
+            {
+                _exporting = false;
+                if (_exporter.joinable())
+                    _exporter.join();
+
+                if (!path.empty()) {
+                    _exporting = true;
+                    _exporter = std::thread(&DynamicsStream::exporter, this, path, period);
+                }
+
+                return *this;
+            }
+
+            const Transport& transport() const { return _transport; }
+
+            // Evaluate the external ds at x; false when the caller has to use its local ds
+            bool query(const Input& x, Output& y)
+            {
+                int64_t stamp = now();
+                bool success = false;
+                _queries++;
+
+                switch (_transport) {
+                case Transport::NATIVE:
+                case Transport::GRID:
+                    if (!_native->contains(x))
+                        return false;
+                    _native->evaluate(x, y);
+                    record(y, stamp);
+                    return true;
+                case Transport::ASYNC:
+                    if (!receive(x, stamp))
+                        return false; // no reply yet
+                    success = !_budget || stamp - _batch.stamp <= _budget + _step * int64_t(_horizon - 1);
+                    break;
+                case Transport::ZMQ:
+                case Transport::SHM:
+                    success = _cursor < _horizon || refresh(x, stamp);
+                    break;
+                }
+
+                if (success) {
+                    y = _batch.y.col(_cursor);
+                    record(y, _batch.stamp + _step * int64_t(_cursor++));
+                    return true;
+                }
+
+                return miss(y);
+            }
+
+            // Seconds elapsed since the state that produced the last reply was sampled
+            double age() const
+            {
+                return _valid ? 1e-9 * (now() - _stamp) : std::numeric_limits<double>::infinity();
+            }
+
+            // Sequence number of the request behind the latest reply of the I/O thread
+            const uint64_t& sequence() const { return _replies.front().sequence; }
+
+            const size_t& queries() const { return _queries; }
+
+            const size_t& misses() const { return _misses; }
+
+            // Latency histograms [ns]
+            const tools::Histogram& roundTrip() const { return _round_trip; }
+
+            const tools::Histogram& compute() const { return _compute; }
+
+            const tools::Histogram& queue() const { return _queue; }
+
+            // Zmq replies lost or not matching their request
+            size_t dropped() const { return _requester.lost() + _requester.stale() + _dropped; }
+
+            // First MAX_RECORDS misses
+            const std::vector<Miss>& missed() const { return _missed; }
+
+        protected:
+            static constexpr size_t MAX_RECORDS = 10000;
+
+            // Predicted states, one per column
+            struct State {
+                Eigen::Matrix<double, In, Eigen::Dynamic> x;
+                int64_t stamp = 0;
+            };
+
+            // Replies to the predicted states
+            struct Reply {
+                Eigen::Matrix<double, Out, Eigen::Dynamic> y;
+                int64_t stamp = 0;
+                uint64_t sequence = 0;
+            };
+
+            static int64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            // Learned model matching the stream dimensions (first or second order)
+            static std::shared_ptr<dynamics::AbstractDynamics<In, Out>> load(const std::string& demo)
+            {
+                static_assert(In == Out || In == 2 * Out, "No learned ds for these dimensions");
+                using Model = typename std::conditional<In == Out, dynamics::FirstGeometry<Out>, dynamics::SecondGeometry<Out>>::type;
+
+                auto model = std::make_shared<Model>();
+                if (!model->load(demo))
+                    return nullptr;
+
+                return model;
+            }
+
+            static std::shared_ptr<dynamics::AbstractDynamics<In, Out>> grid(const std::string& path, std::true_type)
+            {
+                auto model = std::make_shared<dynamics::VoxelGrid<Out>>();
+                if (!model->load(path))
+                    return nullptr;
+
+                return model;
+            }
+
+            static std::shared_ptr<dynamics::AbstractDynamics<In, Out>> grid(const std::string&, std::false_type)
+            {
+                std::cerr << "The grid transport only caches first order ds" << std::endl;
+                return nullptr;
+            }
+
+            // The I/O thread serves the async mode and budgeted zmq requests
+            DynamicsStream& update()
+            {
+                bool threaded = _transport == Transport::ASYNC || (_transport == Transport::ZMQ && _budget);
+
+                if (threaded && !_running)
+                    start();
+                else if (!threaded)
+                    stop();
+
+                return *this;
+            }
+
+            // Size every buffer holding a horizon; no allocation happens afterwards
+            void resize()
+            {
+                State state;
+                state.x.setZero(In, _horizon);
+                Reply reply;
+                reply.y.setZero(Out, _horizon);
+
+                _prediction = state;
+                _batch = reply;
+                _states.fill(state);
+                _replies.fill(reply);
+                _cursor = _horizon;
+            }
+
+            // Forward integration of x over the horizon holding the last reply constant
+            void predict(const Input& x, const int64_t& stamp)
+            {
+                double dt = 1e-9 * _step;
+
+                _prediction.x.col(0) = x;
+                _prediction.stamp = stamp;
+
+                for (Eigen::Index k = 1; k < _prediction.x.cols(); k++) {
+                    _prediction.x.col(k) = _prediction.x.col(k - 1);
+                    if (In == Out)
+                        _prediction.x.col(k).head(Out) += dt * _last;
+                    else {
+                        _prediction.x.col(k).head(Out) += dt * _prediction.x.col(k - 1).segment(Out, Out);
+                        _prediction.x.col(k).tail(Out) += dt * _last;
+                    }
+                }
+            }
+
+            // New blocking request (zmq or shm) for the horizon starting at x
+            bool refresh(const Input& x, const int64_t& stamp)
+            {
+                predict(x, stamp);
+
+                if (_transport == Transport::SHM) {
+                    Eigen::Map<Eigen::VectorXd> y(_batch.y.data(), _batch.y.size());
+                    if (!_shm.request(Eigen::Map<const Eigen::VectorXd>(_prediction.x.data(), _prediction.x.size()), y, _budget ? stamp + _budget : 0))
+                        return false;
+                    observe(stamp, _shm);
+                }
+                else if (_budget) {
+                    if (!wait(stamp))
+                        return false;
+                }
+                else {
+                    Eigen::Map<Eigen::VectorXd> y(_batch.y.data(), _batch.y.size());
+                    if (!_requester.request(Eigen::Map<const Eigen::VectorXd>(_prediction.x.data(), _prediction.x.size()), y, stamp))
+                        return false;
+                    observe(stamp, _requester);
+                }
+
+                _batch.stamp = stamp;
+                _cursor = 0;
+
+                return true;
+            }
+
+            // Hand the prediction to the I/O thread
+            void send(const Input& x, const int64_t& stamp)
+            {
+                predict(x, stamp);
+
+                State& state = _states.back();
+                state.x = _prediction.x;
+                state.stamp = stamp;
+                _states.publish();
+            }
+
+            // Async mode: send x and pick the latest reply matching the current time; false if none yet
+            bool receive(const Input& x, const int64_t& stamp)
+            {
+                send(x, stamp);
+
+                if (_replies.fetch())
+                    _batch = _replies.front();
+
+                if (!_batch.stamp)
+                    return false;
+
+                _cursor = std::min<size_t>((stamp - _batch.stamp) / _step, _horizon - 1);
+
+                return true;
+            }
+
+            // Budgeted zmq request: wait for the reply to this very state until the deadline
+            bool wait(const int64_t& stamp)
+            {
+                State& state = _states.back();
+                state.x = _prediction.x;
+                state.stamp = stamp;
+                _states.publish();
+
+                tools::Spinner spinner;
+                while (true) {
+                    if (_replies.fetch()) {
+                        if (_replies.front().stamp == stamp)
+                            break;
+
+                        // late replies to earlier states still feed the extrapolation
+                        record(_replies.front().y.col(0), _replies.front().stamp);
+                    }
+
+                    if (now() - stamp > _budget)
+                        return false;
+                    spinner.wait();
+                }
+
+                _batch = _replies.front();
+
+                return true;
+            }
+
+            void record(const Output& y, const int64_t& stamp)
+            {
+                if (stamp != _stamp) {
+                    _prev = _last;
+                    _prev_stamp = _stamp;
+                }
+                _last = y;
+                _stamp = stamp;
+                _valid = true;
+            }
+
+            bool miss(Output& y)
+            {
+                int64_t stamp = now();
+
+                if (_missed.size() < MAX_RECORDS)
+                    _missed.push_back({stamp, age()});
+                _misses++;
+
+                // first order extrapolation of the last two replies, within ten budgets
+                if (_fallback == Fallback::EXTRAPOLATE && _valid && _prev_stamp && stamp - _stamp <= 10 * _budget) {
+                    y = _last + (_last - _prev) * double(stamp - _stamp) / double(_stamp - _prev_stamp);
+                    return true;
+                }
+
+                return false;
+            }
+
+            template <typename Requester>
+            void observe(const int64_t& stamp, const Requester& requester)
+            {
+                _round_trip.record(requester.roundTrip());
+                _compute.record(requester.compute());
+                _queue.record(requester.sent() - stamp + requester.queue());
+            }
+
+            void exporter(const std::string& path, const double& period)
+            {
+                std::ofstream file(path);
+                if (!file.is_open()) {
+                    std::cerr << "Unable to open " << path << std::endl;
+                    return;
+                }
+                file << "time,histogram,count,mean,p50,p99,p999,max" << std::endl;
+
+                auto start = std::chrono::steady_clock::now(), next = start;
+                while (_exporting) {
+                    next += std::chrono::nanoseconds(static_cast<int64_t>(1e9 * period));
+                    while (_exporting && std::chrono::steady_clock::now() < next)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+                    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    for (auto& entry : {std::make_pair("round_trip", &_round_trip), std::make_pair("compute", &_compute), std::make_pair("queue", &_queue)})
+                        file << time << "," << entry.first << "," << entry.second->count() << "," << 1e-3 * entry.second->mean()
+                             << "," << 1e-3 * entry.second->percentile(0.5) << "," << 1e-3 * entry.second->percentile(0.99)
+                             << "," << 1e-3 * entry.second->percentile(0.999) << "," << 1e-3 * entry.second->max() << std::endl;
+                }
+            }
+
+            void start()
+            {
+                _running = true;
+                _thread = std::thread(&DynamicsStream::loop, this);
+            }
+
+            void stop()
+            {
+                _running = false;
+                if (_thread.joinable())
+                    _thread.join();
+            }
+
+            void loop()
+            {
+                // zmq sockets must not be shared across threads; the timeout lets the thread exit with a dead server
+                WireRequester requester;
+                requester.configure(_host, _port, 100);
+
+                tools::Spinner spinner;
+
+                while (_running) {
+                    // async mode keeps resending the latest state, budgeted requests are sent once
+                    bool fresh = _states.fetch();
+                    const State& state = _states.front();
+
+                    if (!state.stamp || (!fresh && !_continuous)) {
+                        spinner.wait();
+                        continue;
+                    }
+                    spinner.count = 0;
+
+                    Reply& reply = _replies.back();
+                    Eigen::Map<Eigen::VectorXd> y(reply.y.data(), reply.y.size());
+                    bool received = requester.request(Eigen::Map<const Eigen::VectorXd>(state.x.data(), state.x.size()), y, state.stamp);
+                    _dropped = requester.lost() + requester.stale();
+                    if (!received)
+                        continue; // resend the latest state
+                    observe(state.stamp, requester);
+
+                    reply.stamp = state.stamp;
+                    reply.sequence = requester.sequence();
+                    _replies.publish();
+                }
+            }
+
+            // server address
+            std::string _host, _port;
+
+            Transport _transport;
+
+            // latency budget [ns]
+            int64_t _budget;
+            Fallback _fallback;
+
+            // number of states per request, their spacing [ns] and the next reply to consume
+            size_t _horizon;
+            int64_t _step;
+            size_t _cursor;
+            State _prediction;
+            Reply _batch;
+
+            // synchronous link
+            WireRequester _requester;
+
+            // shared memory link
+            ShmRequester _shm;
+
+            // in-process ds
+            std::shared_ptr<dynamics::AbstractDynamics<In, Out>> _native;
+
+            // asynchronous link
+            std::atomic<bool> _continuous;
+            std::atomic<bool> _running;
+            std::thread _thread;
+            tools::Mailbox<State> _states;
+            tools::Mailbox<Reply> _replies;
+            std::atomic<size_t> _dropped;
+
+            // last two replies
+            bool _valid;
+            Output _last, _prev;
+            int64_t _stamp, _prev_stamp;
+
+            // deadline misses
+            size_t _queries, _misses;
+            std::vector<Miss> _missed;
+
+            // latency telemetry [ns]
+            tools::Histogram _round_trip, _compute, _queue;
+            std::atomic<bool> _exporting;
+            std::thread _exporter;
+        };
+    } // namespace stream
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_STREAM_DYNAMICSSTREAM_HPP
@@ -0,0 +1,93 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_STREAM_MESSAGE_HPP
+#define LEARNEMBEDDING_STREAM_MESSAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+namespace learn_embedding {
+    namespace stream {
+        /*
+            Wire format of the ds link over zmq: a fixed 32-byte header followed by dim
+            doubles, host byte order. scripts/wire_stream.py decodes the same layout.
+
+            The reply carries back sequence and stamp of its request, so that the client can
+            tell late, reordered or lost replies from the expected one, together with the time
+            the request waited on the server and the time spent evaluating the ds.
+        */
+        struct Header {
+            uint64_t sequence; // request counter of the client
+            int64_t stamp; // send time of the request [ns]
+            uint32_t dim; // number of doubles in the payload
+            uint32_t flags;
+            uint32_t queue; // server side wait before evaluation [ns]
+            uint32_t compute; // server side evaluation [ns]
+        };
+
+        static_assert(sizeof(Header) == 32, "Header layout changed");
+
+        struct Message {
+            static constexpr size_t CAPACITY = 256;
+
+            // Fill the message in place; returns the number of bytes to send (0 if x does not fit)
+            template <typename Vector>
+            size_t encode(const uint64_t& sequence, const int64_t& stamp, const Vector& x)
+            {
+                if (size_t(x.size()) > CAPACITY)
+                    return 0;
+
+                header.sequence = sequence;
+                header.stamp = stamp;
+                header.dim = x.size();
+                header.flags = 0;
+                header.queue = 0;
+                header.compute = 0;
+                Eigen::Map<Eigen::VectorXd>(payload, x.size()) = x;
+
+                return size();
+            }
+
+            // Check a message of the given number of bytes received in place
+            bool decode(const size_t& bytes) const
+            {
+                return bytes >= sizeof(Header) && header.dim <= CAPACITY && bytes == size();
+            }
+
+            size_t size() const { return sizeof(Header) + header.dim * sizeof(double); }
+
+            Eigen::Map<const Eigen::VectorXd> data() const { return Eigen::Map<const Eigen::VectorXd>(payload, header.dim); }
+
+            Header header;
+            double payload[CAPACITY];
+        };
+
+        static_assert(offsetof(Message, payload) == sizeof(Header), "Message layout changed");
+    } // namespace stream
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_STREAM_MESSAGE_HPP
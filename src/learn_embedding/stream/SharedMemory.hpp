@@ -0,0 +1,257 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_STREAM_SHAREDMEMORY_HPP
+#define LEARNEMBEDDING_STREAM_SHAREDMEMORY_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/tools/SpscRing.hpp"
+
+namespace learn_embedding {
+    namespace stream {
+        /*
+            Fixed-size frame exchanged over shared memory.
+            The layout is mirrored by scripts/shm_stream.py, keep the two in sync.
+        */
+        struct Frame {
+            static constexpr size_t CAPACITY = 16;
+
+            uint64_t sequence;
+            int64_t stamp;
+            uint32_t dim;
+            uint32_t compute; // server side evaluation of the reply [ns]
+            double data[CAPACITY];
+        };
+
+        /*
+            Segment in /dev/shm: a request ring (client -> server) and a reply ring (server -> client).
+        */
+        struct Segment {
+            static constexpr uint32_t MAGIC = 0x44534c4b; // "DSLK"
+            static constexpr size_t FRAMES = 16;
+
+            alignas(64) uint32_t magic;
+            tools::SpscRing<Frame, FRAMES> requests;
+            tools::SpscRing<Frame, FRAMES> replies;
+        };
+
+        static_assert(sizeof(Frame) == 152, "Frame layout changed");
+        static_assert(offsetof(Segment, requests) == 64 && offsetof(Segment, replies) == 2624 && sizeof(Segment) == 5184, "Segment layout changed");
+
+        class SharedMemory {
+        public:
+            SharedMemory() : _segment(nullptr) {}
+
+            ~SharedMemory()
+            {
+                if (_segment)
+                    munmap(_segment, sizeof(Segment));
+            }
+
+            // Open (or create) /dev/shm/<name>
+            bool open(const std::string& name)
+            {
+                int fd = shm_open(("/" + name).c_str(), O_CREAT | O_RDWR, 0666);
+                if (fd < 0 || ftruncate(fd, sizeof(Segment))) {
+                    std::cerr << "Unable to open shared memory " << name << std::endl;
+                    return false;
+                }
+
+                void* ptr = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                close(fd);
+                if (ptr == MAP_FAILED) {
+                    std::cerr << "Unable to map shared memory " << name << std::endl;
+                    return false;
+                }
+
+                // fresh segments are zero filled, which is a valid empty state
+                _segment = static_cast<Segment*>(ptr);
+                _segment->magic = Segment::MAGIC;
+
+                return true;
+            }
+
+            Segment* segment() { return _segment; }
+
+        protected:
+            Segment* _segment;
+        };
+
+        /*
+            Client side, drop-in alternative to WireRequester on the same host.
+        */
+        class ShmRequester {
+        public:
+            ShmRequester() : _sequence(0), _sent(0), _round_trip(0), _compute(0) {}
+
+            bool configure(const std::string& name)
+            {
+                if (!_memory.open(name))
+                    return false;
+
+                // discard replies left over by a previous client
+                _memory.segment()->replies.drain();
+
+                return true;
+            }
+
+            // Blocking request; spins on the reply ring until the deadline (steady clock, ns; 0 waits forever).
+            // Fails if x does not fit in a frame or the reply does not have the size of y.
+            template <typename Input, typename Output>
+            bool request(const Input& x, Output& y, const int64_t& deadline = 0)
+            {
+                Segment* segment = _memory.segment();
+
+                if (static_cast<size_t>(x.size()) > Frame::CAPACITY) {
+                    std::cerr << "Request of " << x.size() << " exceeds the frame capacity " << Frame::CAPACITY << std::endl;
+                    return false;
+                }
+
+                tools::Spinner spinner;
+                Frame* frame;
+                while (!(frame = segment->requests.prepare())) {
+                    if (expired(deadline))
+                        return false;
+                    spinner.wait();
+                }
+                _sent = now();
+                frame->sequence = ++_sequence;
+                frame->stamp = _sent;
+                frame->dim = x.size();
+                Eigen::Map<Eigen::VectorXd>(frame->data, x.size()) = x;
+                segment->requests.commit();
+
+                // a reply arriving after the deadline is dropped as stale by the next request
+                const Frame* reply;
+                while (!(reply = segment->replies.peek()) || reply->sequence != _sequence) {
+                    if (reply)
+                        segment->replies.release(); // stale
+                    else if (expired(deadline))
+                        return false;
+                    spinner.wait();
+                }
+                _round_trip = now() - _sent;
+                _compute = reply->compute;
+
+                // the server could not evaluate the request (dim 0) or serves another model
+                bool valid = reply->dim == static_cast<uint32_t>(y.size());
+                if (valid)
+                    y = Eigen::Map<const Eigen::VectorXd>(reply->data, y.size());
+                segment->replies.release();
+
+                return valid;
+            }
+
+            // Timings of the last request [ns]: send time (steady clock), round trip and server evaluation
+            const int64_t& sent() const { return _sent; }
+
+            const int64_t& roundTrip() const { return _round_trip; }
+
+            const int64_t& compute() const { return _compute; }
+
+            // Requests are served in order, no server side queue
+            int64_t queue() const { return 0; }
+
+        protected:
+            static int64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            static bool expired(const int64_t& deadline)
+            {
+                return deadline && now() > deadline;
+            }
+
+            SharedMemory _memory;
+            uint64_t _sequence;
+            int64_t _sent, _round_trip, _compute;
+        };
+
+        /*
+            Server side; scripts/shm_stream.py provides the same replier for the python model server.
+        */
+        class ShmReplier {
+        public:
+            bool configure(const std::string& name)
+            {
+                if (!_memory.open(name))
+                    return false;
+
+                _memory.segment()->requests.drain();
+
+                return true;
+            }
+
+            // Serve one request with f(x, y); false if none is pending.
+            // Requests or replies larger than a frame are answered with an empty (dim 0) reply.
+            template <typename Function>
+            bool reply(Function&& f, const size_t& dim)
+            {
+                Segment* segment = _memory.segment();
+
+                const Frame* request = segment->requests.peek();
+                if (!request)
+                    return false;
+
+                tools::Spinner spinner;
+                Frame* frame;
+                while (!(frame = segment->replies.prepare()))
+                    spinner.wait();
+
+                auto start = std::chrono::steady_clock::now();
+                if (dim <= Frame::CAPACITY && request->dim <= Frame::CAPACITY) {
+                    Eigen::Map<Eigen::VectorXd> y(frame->data, dim);
+                    f(Eigen::Map<const Eigen::VectorXd>(request->data, request->dim), y);
+                    frame->dim = dim;
+                }
+                else
+                    frame->dim = 0;
+                frame->compute = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                frame->sequence = request->sequence;
+                frame->stamp = request->stamp;
+                segment->requests.release();
+                segment->replies.commit();
+
+                return true;
+            }
+
+        protected:
+            SharedMemory _memory;
+        };
+    } // namespace stream
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_STREAM_SHAREDMEMORY_HPP
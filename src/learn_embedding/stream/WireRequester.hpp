@@ -0,0 +1,126 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_STREAM_WIREREQUESTER_HPP
+#define LEARNEMBEDDING_STREAM_WIREREQUESTER_HPP
+
+#include <chrono>
+#include <string>
+
+#include <zmq.hpp>
+
+#include "learn_embedding/stream/Message.hpp"
+
+namespace learn_embedding {
+    namespace stream {
+        /*
+            zmq request socket speaking the fixed-layout Message format.
+
+            Requests are encoded into and replies received directly in preallocated messages,
+            so no memory is allocated per request. The socket is relaxed and correlated: after
+            a timeout a new request can be sent and the late reply to the old one is dropped.
+        */
+        class WireRequester {
+        public:
+            WireRequester() : _context(1), _socket(_context, zmq::socket_type::req), _sequence(0), _stale(0), _lost(0), _sent(0), _round_trip(0) {}
+
+            // Connect to tcp://host:port; replies are awaited at most timeout ms (-1 waits forever)
+            WireRequester& configure(const std::string& host, const std::string& port, const int& timeout = -1)
+            {
+                if (!_endpoint.empty())
+                    _socket.disconnect(_endpoint);
+
+                _endpoint = "tcp://" + host + ":" + port;
+                _socket.set(zmq::sockopt::linger, 0);
+                _socket.set(zmq::sockopt::req_relaxed, 1);
+                _socket.set(zmq::sockopt::req_correlate, 1);
+                _socket.set(zmq::sockopt::rcvtimeo, timeout);
+                _socket.connect(_endpoint);
+
+                return *this;
+            }
+
+            // Send x and write the reply into y; false on timeout or on a malformed/mismatched reply
+            template <typename Input, typename Output>
+            bool request(const Input& x, Output& y, const int64_t& stamp = 0)
+            {
+                size_t bytes = _request.encode(++_sequence, stamp, x);
+                _sent = now();
+                if (!bytes || !_socket.send(zmq::const_buffer(&_request, bytes), zmq::send_flags::none))
+                    return false;
+
+                auto received = _socket.recv(zmq::mutable_buffer(&_reply, sizeof(Message)), zmq::recv_flags::none);
+                _round_trip = now() - _sent;
+                if (!received) {
+                    _lost++;
+                    return false;
+                }
+
+                if (received->truncated() || !_reply.decode(received->size) || _reply.header.sequence != _sequence || _reply.header.dim != size_t(y.size())) {
+                    _stale++;
+                    return false;
+                }
+
+                y = _reply.data();
+
+                return true;
+            }
+
+            // Timings of the last request [ns]: send time (steady clock), round trip and server side wait/evaluation
+            const int64_t& sent() const { return _sent; }
+
+            const int64_t& roundTrip() const { return _round_trip; }
+
+            int64_t queue() const { return _reply.header.queue; }
+
+            int64_t compute() const { return _reply.header.compute; }
+
+            // Sequence number of the last request
+            const uint64_t& sequence() const { return _sequence; }
+
+            // Replies that did not match their request
+            const size_t& stale() const { return _stale; }
+
+            // Requests left without reply within the timeout
+            const size_t& lost() const { return _lost; }
+
+        protected:
+            static int64_t now()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            zmq::context_t _context;
+            zmq::socket_t _socket;
+            std::string _endpoint;
+
+            Message _request, _reply;
+            uint64_t _sequence;
+            size_t _stale, _lost;
+            int64_t _sent, _round_trip;
+        };
+    } // namespace stream
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_STREAM_WIREREQUESTER_HPP
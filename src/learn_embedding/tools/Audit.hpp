@@ -0,0 +1,273 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_TOOLS_AUDIT_HPP
+#define LEARNEMBEDDING_TOOLS_AUDIT_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <dlfcn.h>
+#include <malloc.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Debug builds count heap allocations (define LEARNEMBEDDING_COUNT_ALLOCATIONS to force it in release)
+#if !defined(NDEBUG) && !defined(LEARNEMBEDDING_COUNT_ALLOCATIONS)
+#define LEARNEMBEDDING_COUNT_ALLOCATIONS
+#endif
+
+// Audit mode (configure with --audit) also counts locks and blocking I/O; without either nothing is interposed
+#if defined(LEARNEMBEDDING_AUDIT) && !defined(LEARNEMBEDDING_COUNT_ALLOCATIONS)
+#define LEARNEMBEDDING_COUNT_ALLOCATIONS
+#endif
+
+namespace learn_embedding {
+    namespace tools {
+        enum Event {
+            ALLOCATION = 0,
+            LOCK,
+            IO,
+            EVENTS
+        };
+
+        using Events = std::array<uint64_t, EVENTS>;
+
+        // Events of the calling thread so far (always 0 for the kinds that are not counted)
+        inline Events& events()
+        {
+            static thread_local Events count = {0, 0, 0};
+            return count;
+        }
+
+        /*
+            Real-time audit of a recurring call, e.g. a controller action().
+
+            A Scope placed at the top of the call adds the events of the current thread
+            between its construction and destruction: heap allocations in debug builds
+            (LEARNEMBEDDING_COUNT_ALLOCATIONS), plus mutex locks and blocking I/O (reads,
+            writes, socket receives, polls, stdio, sleeps) in audit mode (LEARNEMBEDDING_AUDIT);
+            otherwise a Scope only reads a thread local and no report is printed. Nothing is printed while auditing, the
+            report (per event: total, offending calls, worst call, first offending call)
+            is printed on destruction.
+            Counting relies on the functions below being interposed, so this header must
+            be included by the program's main translation unit only.
+        */
+        class Audit {
+        public:
+            Audit(const std::string& name) : _name(name), _calls(0)
+            {
+                _total.fill(0);
+                _dirty.fill(0);
+                _max.fill(0);
+                _first.fill(0);
+            }
+
+            ~Audit()
+            {
+#ifdef LEARNEMBEDDING_COUNT_ALLOCATIONS
+                if (_calls)
+                    report(std::cout);
+#endif
+            }
+
+            struct Scope {
+                Scope(Audit& audit) : _audit(audit), _start(events()) {}
+
+                ~Scope()
+                {
+                    const Events& now = events();
+                    Events delta;
+                    for (size_t i = 0; i < EVENTS; i++)
+                        delta[i] = now[i] - _start[i];
+                    _audit.record(delta);
+                }
+
+                Audit& _audit;
+                Events _start;
+            };
+
+            void record(const Events& delta)
+            {
+                _calls++;
+                for (size_t i = 0; i < EVENTS; i++)
+                    if (delta[i]) {
+                        if (!_dirty[i])
+                            _first[i] = _calls;
+                        _dirty[i]++;
+                        _total[i] += delta[i];
+                        _max[i] = std::max(_max[i], delta[i]);
+                    }
+            }
+
+            const uint64_t& calls() const { return _calls; }
+            const uint64_t& total(const Event& event) const { return _total[event]; }
+            const uint64_t& dirty(const Event& event) const { return _dirty[event]; }
+
+            // Whether no audited call allocated, locked or blocked
+            bool clean() const { return !_dirty[ALLOCATION] && !_dirty[LOCK] && !_dirty[IO]; }
+
+            void report(std::ostream& os) const
+            {
+                static const char* names[EVENTS] = {"allocations", "locks", "blocking io"};
+#ifdef LEARNEMBEDDING_AUDIT
+                size_t events = EVENTS;
+#else
+                size_t events = LOCK;
+#endif
+
+                os << _name << ": " << _calls << " calls" << (clean() ? ", clean" : "") << std::endl;
+                for (size_t i = 0; i < events; i++) {
+                    os << "    " << names[i] << " " << _total[i] << " in " << _dirty[i] << " calls";
+                    if (_dirty[i])
+                        os << ", max " << _max[i] << " per call, first at call " << _first[i];
+                    os << std::endl;
+                }
+            }
+
+        protected:
+            std::string _name;
+            uint64_t _calls;
+            Events _total, _dirty, _max, _first;
+        };
+
+        // Next definition of an interposed function, resolved on first use without locking
+        template <typename F>
+        F next(std::atomic<F>& cached, const char* name)
+        {
+            F f = cached.load(std::memory_order_relaxed);
+            if (!f) {
+                f = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+                cached.store(f, std::memory_order_relaxed);
+            }
+            return f;
+        }
+    } // namespace tools
+} // namespace learn_embedding
+
+#ifdef LEARNEMBEDDING_COUNT_ALLOCATIONS
+// glibc entry points; operator new and Eigen's aligned_malloc both end up here
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) noexcept
+{
+    learn_embedding::tools::events()[learn_embedding::tools::ALLOCATION]++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    learn_embedding::tools::events()[learn_embedding::tools::ALLOCATION]++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+    learn_embedding::tools::events()[learn_embedding::tools::ALLOCATION]++;
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept
+{
+    learn_embedding::tools::events()[learn_embedding::tools::ALLOCATION]++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    learn_embedding::tools::events()[learn_embedding::tools::ALLOCATION]++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+{
+    learn_embedding::tools::events()[learn_embedding::tools::ALLOCATION]++;
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+void free(void* ptr) noexcept { __libc_free(ptr); }
+}
+#endif
+
+#ifdef LEARNEMBEDDING_AUDIT
+// Count the call and forward it to the next definition (libc or libpthread)
+#define LEARNEMBEDDING_AUDIT_FORWARD(event, ret, function, params, args)                                  \
+    ret function params noexcept                                                                         \
+    {                                                                                                    \
+        static std::atomic<ret(*) params> real(nullptr);                                                 \
+        learn_embedding::tools::events()[learn_embedding::tools::event]++;                               \
+        return learn_embedding::tools::next(real, #function) args;                                       \
+    }
+
+extern "C" {
+// locks
+LEARNEMBEDDING_AUDIT_FORWARD(LOCK, int, pthread_mutex_lock, (pthread_mutex_t * mutex), (mutex))
+LEARNEMBEDDING_AUDIT_FORWARD(LOCK, int, pthread_rwlock_rdlock, (pthread_rwlock_t * lock), (lock))
+LEARNEMBEDDING_AUDIT_FORWARD(LOCK, int, pthread_rwlock_wrlock, (pthread_rwlock_t * lock), (lock))
+
+// blocking io: raw reads and writes, socket receives and polls (a zmq recv waits in poll), stdio (std::cout), syncs and sleeps
+LEARNEMBEDDING_AUDIT_FORWARD(IO, ssize_t, read, (int fd, void* buffer, size_t count), (fd, buffer, count))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, ssize_t, readv, (int fd, const struct iovec* iov, int count), (fd, iov, count))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, ssize_t, recv, (int fd, void* buffer, size_t length, int flags), (fd, buffer, length, flags))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, ssize_t, recvfrom, (int fd, void* buffer, size_t length, int flags, struct sockaddr* address, socklen_t* address_length), (fd, buffer, length, flags, address, address_length))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, ssize_t, recvmsg, (int fd, struct msghdr* message, int flags), (fd, message, flags))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, poll, (struct pollfd * fds, nfds_t count, int timeout), (fds, count, timeout))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, ppoll, (struct pollfd * fds, nfds_t count, const struct timespec* timeout, const sigset_t* mask), (fds, count, timeout, mask))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, select, (int count, fd_set* read, fd_set* write, fd_set* except, struct timeval* timeout), (count, read, write, except, timeout))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, pselect, (int count, fd_set* read, fd_set* write, fd_set* except, const struct timespec* timeout, const sigset_t* mask), (count, read, write, except, timeout, mask))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, epoll_wait, (int epoll, struct epoll_event* events, int count, int timeout), (epoll, events, count, timeout))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, ssize_t, write, (int fd, const void* buffer, size_t count), (fd, buffer, count))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, ssize_t, writev, (int fd, const struct iovec* iov, int count), (fd, iov, count))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, size_t, fwrite, (const void* buffer, size_t size, size_t count, FILE* stream), (buffer, size, count, stream))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, fputs, (const char* string, FILE* stream), (string, stream))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, puts, (const char* string), (string))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, fflush, (FILE * stream), (stream))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, fsync, (int fd), (fd))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, nanosleep, (const struct timespec* duration, struct timespec* remaining), (duration, remaining))
+LEARNEMBEDDING_AUDIT_FORWARD(IO, int, clock_nanosleep, (clockid_t clock, int flags, const struct timespec* duration, struct timespec* remaining), (clock, flags, duration, remaining))
+}
+
+#undef LEARNEMBEDDING_AUDIT_FORWARD
+#endif
+
+#endif // LEARNEMBEDDING_TOOLS_AUDIT_HPP
@@ -0,0 +1,146 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_TOOLS_HISTOGRAM_HPP
+#define LEARNEMBEDDING_TOOLS_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace learn_embedding {
+    namespace tools {
+        /*
+            Log-linear latency histogram in the spirit of HdrHistogram.
+
+            Values (ns) below 2^BITS are counted exactly; above, every power of two is split
+            in 2^(BITS - 1) sub-buckets, i.e. a relative resolution of 1.6% up to MAX.
+            The buckets are fixed, so recording is a couple of integer ops and never allocates.
+            A single thread records; other threads may read at any time and get a slightly
+            inconsistent but safe snapshot (relaxed atomics).
+        */
+        class Histogram {
+        public:
+            static constexpr int BITS = 7;
+            static constexpr int MAGNITUDES = 40; // MAX = 2^40 ns, about 18 minutes
+            static constexpr size_t HALF = size_t(1) << (BITS - 1);
+            static constexpr size_t BUCKETS = (size_t(1) << BITS) + (MAGNITUDES - BITS + 1) * HALF;
+            static constexpr uint64_t MAX = (uint64_t(1) << MAGNITUDES) - 1;
+
+            Histogram() { reset(); }
+
+            void record(int64_t value)
+            {
+                uint64_t v = std::min<uint64_t>(std::max<int64_t>(value, 0), MAX);
+                increment(_counts[index(v)]);
+                increment(_count);
+                _sum.store(_sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+                if (v > _max.load(std::memory_order_relaxed))
+                    _max.store(v, std::memory_order_relaxed);
+            }
+
+            void reset()
+            {
+                for (auto& count : _counts)
+                    count.store(0, std::memory_order_relaxed);
+                _count.store(0, std::memory_order_relaxed);
+                _sum.store(0, std::memory_order_relaxed);
+                _max.store(0, std::memory_order_relaxed);
+            }
+
+            uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+
+            uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+            double mean() const { return count() ? double(_sum.load(std::memory_order_relaxed)) / count() : 0.0; }
+
+            // Value below which a fraction p of the samples lies (bucket midpoint)
+            double percentile(const double& p) const
+            {
+                uint64_t total = count(), rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * total + 0.5)), seen = 0;
+                if (!total)
+                    return 0.0;
+
+                for (size_t i = 0; i < BUCKETS; i++) {
+                    seen += _counts[i].load(std::memory_order_relaxed);
+                    if (seen >= rank)
+                        return std::min<double>(lower(i) + 0.5 * (width(i) - 1), max());
+                }
+
+                return max();
+            }
+
+            // One line summary in microseconds
+            void print(const std::string& name, std::ostream& os) const
+            {
+                os << name
+                   << " n " << count()
+                   << " mean " << 1e-3 * mean()
+                   << " p50 " << 1e-3 * percentile(0.5)
+                   << " p99 " << 1e-3 * percentile(0.99)
+                   << " p99.9 " << 1e-3 * percentile(0.999)
+                   << " max " << 1e-3 * max() << " [us]" << std::endl;
+            }
+
+        protected:
+            static int msb(const uint64_t& v) { return 63 - __builtin_clzll(v); }
+
+            static size_t index(const uint64_t& v)
+            {
+                if (v < (uint64_t(1) << BITS))
+                    return v;
+
+                int shift = msb(v) - (BITS - 1);
+                return (size_t(1) << BITS) + (shift - 1) * HALF + ((v >> shift) - HALF);
+            }
+
+            static uint64_t lower(const size_t& i)
+            {
+                if (i < (size_t(1) << BITS))
+                    return i;
+
+                size_t j = i - (size_t(1) << BITS);
+                return (HALF + j % HALF) << (j / HALF + 1);
+            }
+
+            static uint64_t width(const size_t& i)
+            {
+                return (i < (size_t(1) << BITS)) ? 1 : uint64_t(1) << ((i - (size_t(1) << BITS)) / HALF + 1);
+            }
+
+            // single writer: no read-modify-write needed
+            static void increment(std::atomic<uint64_t>& counter)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+            std::atomic<uint64_t> _counts[BUCKETS];
+            std::atomic<uint64_t> _count, _sum, _max;
+        };
+    } // namespace tools
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_TOOLS_HISTOGRAM_HPP
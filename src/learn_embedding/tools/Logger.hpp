@@ -0,0 +1,172 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_TOOLS_LOGGER_HPP
+#define LEARNEMBEDDING_TOOLS_LOGGER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/tools/SpscRing.hpp"
+
+namespace learn_embedding {
+    namespace tools {
+        /*
+            Row logger for the control loop, in place of FileManager::append.
+
+            append() copies a row of Size doubles into a preallocated SPSC ring and returns;
+            a background thread drains the ring every few milliseconds, formats the rows as
+            space separated text (the layout FileManager reads back) and writes them in
+            batches. When the ring is full the row is dropped and counted, never waited for.
+            Capacity rows cover about Capacity ms at 1 kHz of disk stalls. Pending rows are
+            written when the logger is closed or destroyed.
+        */
+        template <size_t Size, size_t Capacity = 8192>
+        class Logger {
+        public:
+            using Record = std::array<double, Size>;
+
+            Logger() : _ring(std::make_unique<SpscRing<Record, Capacity>>()), _running(false), _dropped(0), _written(0) { _ring->reset(); }
+
+            ~Logger() { close(); }
+
+            // Open (truncate) the file and start the writer thread
+            Logger& setFile(const std::string& path)
+            {
+                close();
+
+                _file.open(path);
+                if (!_file.is_open()) {
+                    std::cerr << "Unable to open " << path << std::endl;
+                    return *this;
+                }
+                _path = path;
+                _ring->reset();
+                _dropped = 0;
+                _written = 0;
+
+                _running = true;
+                _thread = std::thread(&Logger::loop, this);
+
+                return *this;
+            }
+
+            // Control loop side: queue one row, false if it was dropped (ring full or no file)
+            template <typename Derived>
+            bool append(const Eigen::DenseBase<Derived>& row)
+            {
+                Record* record = _running ? _ring->prepare() : nullptr;
+                if (!record) {
+                    _dropped.store(_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return false;
+                }
+
+                Eigen::Map<Eigen::Matrix<double, 1, Size>>(record->data()) = row;
+                _ring->commit();
+
+                return true;
+            }
+
+            // Stop the writer after flushing the pending rows; reports dropped rows
+            void close()
+            {
+                if (!_running)
+                    return;
+
+                _running = false;
+                if (_thread.joinable())
+                    _thread.join();
+                _file.close();
+
+                if (dropped())
+                    std::cerr << _path << ": dropped " << dropped() << " rows of " << dropped() + written() << std::endl;
+            }
+
+            // Rows lost to a full ring, rows written so far
+            uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+            uint64_t written() const { return _written.load(std::memory_order_relaxed); }
+
+        protected:
+            void loop()
+            {
+                std::string buffer;
+                buffer.reserve(1 << 16);
+                char number[32];
+
+                bool running = true;
+                while (running) {
+                    // read the flag before draining, so that the last pass sees every row appended before close()
+                    running = _running;
+
+                    Record record;
+                    while (_ring->pop(record)) {
+                        for (size_t i = 0; i < Size; i++) {
+                            int length = std::snprintf(number, sizeof(number), i ? " %.17g" : "%.17g", record[i]);
+                            buffer.append(number, length);
+                        }
+                        buffer.push_back('\n');
+                        _written.store(_written.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+                        if (buffer.size() >= (1 << 16)) {
+                            _file.write(buffer.data(), buffer.size());
+                            buffer.clear();
+                        }
+                    }
+
+                    if (!buffer.empty()) {
+                        _file.write(buffer.data(), buffer.size());
+                        _file.flush();
+                        buffer.clear();
+                    }
+
+                    if (running)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+
+            std::string _path;
+            std::ofstream _file;
+
+            // on the heap: Capacity rows do not belong in the controller object
+            std::unique_ptr<SpscRing<Record, Capacity>> _ring;
+            std::atomic<bool> _running;
+            std::thread _thread;
+
+            std::atomic<uint64_t> _dropped, _written;
+        };
+    } // namespace tools
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_TOOLS_LOGGER_HPP
@@ -0,0 +1,92 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_TOOLS_MAILBOX_HPP
+#define LEARNEMBEDDING_TOOLS_MAILBOX_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace learn_embedding {
+    namespace tools {
+        /*
+            Latest-value exchange between one writer and one reader thread.
+
+            The front/back pair is double buffered through a third spare slot so that
+            neither side ever waits: the writer fills its back slot and swaps it with the
+            spare, the reader swaps the spare with its front slot only when something new
+            has been published. Older values are overwritten, never queued.
+        */
+        template <typename T>
+        class Mailbox {
+        public:
+            Mailbox() : _write(0), _spare(1), _read(2) {}
+
+            // Initialize every slot, e.g. to preallocate dynamic members; not thread safe
+            void fill(const T& value)
+            {
+                for (auto& slot : _slots)
+                    slot = value;
+            }
+
+            // Slot owned by the writer; fill it then call publish()
+            T& back() { return _slots[_write]; }
+
+            void publish()
+            {
+                _write = _spare.exchange(_write | DIRTY, std::memory_order_acq_rel) & INDEX;
+            }
+
+            void write(const T& value)
+            {
+                back() = value;
+                publish();
+            }
+
+            // Swap in the most recent value if any; returns true when it was new
+            bool fetch()
+            {
+                if (!(_spare.load(std::memory_order_relaxed) & DIRTY))
+                    return false;
+
+                _read = _spare.exchange(_read, std::memory_order_acq_rel) & INDEX;
+
+                return true;
+            }
+
+            // Slot owned by the reader; valid until the next fetch()
+            const T& front() const { return _slots[_read]; }
+
+        protected:
+            static constexpr uint8_t INDEX = 0x3, DIRTY = 0x4;
+
+            T _slots[3];
+            uint8_t _write;
+            std::atomic<uint8_t> _spare;
+            uint8_t _read;
+        };
+    } // namespace tools
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_TOOLS_MAILBOX_HPP
@@ -0,0 +1,222 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_TOOLS_MULTIRATE_HPP
+#define LEARNEMBEDDING_TOOLS_MULTIRATE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#include <Eigen/Core>
+
+#include "learn_embedding/tools/Histogram.hpp"
+#include "learn_embedding/tools/Mailbox.hpp"
+
+namespace learn_embedding {
+    namespace tools {
+        /*
+            Joint reference planned at a low rate for a fast control loop.
+
+            The control loop publishes its state every tick with update(); a background thread
+            wakes up every period, takes the latest state and runs the planner on it (e.g. an
+            IK/ID QP), which returns a waypoint: joint position and velocity at the time of that
+            state. The control loop reads the waypoint back through a mailbox and follows it by
+            linear interpolation, q_ref(t) = q + (t - t_plan) dq, extrapolating at most horizon
+            periods ahead and holding still after that (a stalled planner never drives the
+            reference away). Neither side waits for the other; the fast path is two mailbox
+            swaps and a few vector ops.
+
+            A planner standing in for a reference computed inline, q_ref = q + dt dq with dt the
+            control step, should return that same waypoint (q + dt dq, dq) whatever its own period:
+            the control loop extrapolates along dq for the time elapsed since the planned state, so
+            at every tick the reference keeps the one-step lead of the inline law instead of
+            jumping a planner period ahead when a new waypoint arrives.
+
+            Times are those passed to update() by the control loop (seconds); the planner
+            itself is paced by the wall clock.
+        */
+        template <int Dofs = 7>
+        class MultiRate {
+        public:
+            using Configuration = Eigen::Matrix<double, Dofs, 1>;
+
+            struct State {
+                Configuration q, dq;
+                double time;
+            };
+
+            struct Reference {
+                Configuration q, dq;
+                double time;
+            };
+
+            MultiRate() : _period(1e-2), _horizon(2.0), _running(false), _plans(0), _overruns(0), _stalls(0)
+            {
+                _position.setZero();
+                _velocity.setZero();
+            }
+
+            ~MultiRate() { stop(); }
+
+            // Planner period [s]
+            MultiRate& setPeriod(const double& period)
+            {
+                _period = period;
+                return *this;
+            }
+
+            // Extrapolation limit past the latest waypoint, in planner periods
+            MultiRate& setHorizon(const double& periods)
+            {
+                _horizon = periods;
+                return *this;
+            }
+
+            const double& period() const { return _period; }
+
+            /*
+                Start planning; planner(const State&, Reference&) fills the waypoint for a
+                state and runs on the background thread only, so whatever it touches (model
+                workspace, QP, task DS) must not be used by the control loop meanwhile. Until
+                the first plan the reference holds q at rest.
+            */
+            template <typename Planner>
+            void start(const Configuration& q, const double& time, Planner planner)
+            {
+                stop();
+
+                State state{q, Configuration::Zero(), time};
+                _states.fill(state);
+
+                Reference reference{q, Configuration::Zero(), time};
+                _references.fill(reference);
+
+                _position = q;
+                _velocity.setZero();
+
+                _running = true;
+                _thread = std::thread([this, planner]() mutable { loop(planner); });
+            }
+
+            void stop()
+            {
+                _running = false;
+                if (_thread.joinable())
+                    _thread.join();
+            }
+
+            // Control loop: publish the measured state and interpolate the reference at time
+            template <typename Q, typename DQ>
+            void update(const Eigen::MatrixBase<Q>& q, const Eigen::MatrixBase<DQ>& dq, const double& time)
+            {
+                State& state = _states.back();
+                state.q = q;
+                state.dq = dq;
+                state.time = time;
+                _states.publish();
+
+                _references.fetch();
+                const Reference& reference = _references.front();
+
+                double elapsed = std::max(time - reference.time, 0.0), limit = _horizon * _period;
+                if (elapsed <= limit) {
+                    _position = reference.q + elapsed * reference.dq;
+                    _velocity = reference.dq;
+                }
+                else {
+                    _stalls.store(_stalls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    _position = reference.q + limit * reference.dq;
+                    _velocity.setZero();
+                }
+            }
+
+            // Interpolated reference of the last update()
+            const Configuration& position() const { return _position; }
+
+            const Configuration& velocity() const { return _velocity; }
+
+            // Plans so far, plans that overran the period, control ticks past the horizon of the latest waypoint
+            uint64_t plans() const { return _plans.load(std::memory_order_relaxed); }
+
+            uint64_t overruns() const { return _overruns.load(std::memory_order_relaxed); }
+
+            uint64_t stalls() const { return _stalls.load(std::memory_order_relaxed); }
+
+            // Planner run times [ns]
+            const Histogram& latency() const { return _latency; }
+
+        protected:
+            template <typename Planner>
+            void loop(Planner& planner)
+            {
+                auto next = std::chrono::steady_clock::now();
+                auto period = std::chrono::nanoseconds(static_cast<int64_t>(1e9 * _period));
+
+                while (_running) {
+                    // no new state: the control loop is not running yet (or anymore)
+                    if (_states.fetch()) {
+                        auto start = std::chrono::steady_clock::now();
+
+                        const State& state = _states.front();
+                        Reference& reference = _references.back();
+                        reference.time = state.time;
+                        planner(state, reference);
+                        _references.publish();
+
+                        _latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+                        _plans.store(_plans.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    }
+
+                    next += period;
+                    auto now = std::chrono::steady_clock::now();
+                    if (now > next) {
+                        _overruns.store(_overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                        next = now;
+                    }
+                    else
+                        std::this_thread::sleep_until(next);
+                }
+            }
+
+            double _period, _horizon;
+
+            std::atomic<bool> _running;
+            std::thread _thread;
+            Mailbox<State> _states;
+            Mailbox<Reference> _references;
+
+            // control loop side
+            Configuration _position, _velocity;
+
+            std::atomic<uint64_t> _plans, _overruns, _stalls;
+            Histogram _latency;
+        };
+    } // namespace tools
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_TOOLS_MULTIRATE_HPP
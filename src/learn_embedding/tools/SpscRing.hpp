@@ -0,0 +1,133 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_TOOLS_SPSCRING_HPP
+#define LEARNEMBEDDING_TOOLS_SPSCRING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+
+namespace learn_embedding {
+    namespace tools {
+        // Busy-wait hint for spinning consumers
+        inline void cpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+
+        // Spin for a while, then give the core away (the peer may share it)
+        struct Spinner {
+            void wait()
+            {
+                if (++count < 1000)
+                    cpuRelax();
+                else
+                    std::this_thread::yield();
+            }
+
+            size_t count = 0;
+        };
+
+        /*
+            Lock-free single-producer/single-consumer ring of fixed-size POD frames.
+
+            Head and tail live on separate cache lines and the layout is fixed, so the ring
+            can be placed in shared memory and accessed by another process (see stream/SharedMemory.hpp).
+            N must be a power of two.
+        */
+        template <typename T, size_t N>
+        class SpscRing {
+            static_assert((N & (N - 1)) == 0, "Ring capacity must be a power of two");
+            static_assert(std::is_trivially_copyable<T>::value, "Ring frames must be POD");
+            static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring indices must be address free");
+
+        public:
+            void reset()
+            {
+                _head.store(0, std::memory_order_relaxed);
+                _tail.store(0, std::memory_order_relaxed);
+            }
+
+            // Producer side
+            T* prepare()
+            {
+                uint64_t head = _head.load(std::memory_order_relaxed);
+                if (head - _tail.load(std::memory_order_acquire) == N)
+                    return nullptr;
+                return &_frames[head & (N - 1)];
+            }
+
+            void commit() { _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+            bool push(const T& frame)
+            {
+                T* slot = prepare();
+                if (!slot)
+                    return false;
+                *slot = frame;
+                commit();
+                return true;
+            }
+
+            // Consumer side
+            const T* peek() const
+            {
+                uint64_t tail = _tail.load(std::memory_order_relaxed);
+                if (tail == _head.load(std::memory_order_acquire))
+                    return nullptr;
+                return &_frames[tail & (N - 1)];
+            }
+
+            void release() { _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+            bool pop(T& frame)
+            {
+                const T* slot = peek();
+                if (!slot)
+                    return false;
+                frame = *slot;
+                release();
+                return true;
+            }
+
+            // Drop everything pending (consumer side)
+            void drain() { _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release); }
+
+            size_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+
+            static constexpr size_t capacity() { return N; }
+
+        protected:
+            alignas(64) std::atomic<uint64_t> _head;
+            alignas(64) std::atomic<uint64_t> _tail;
+            alignas(64) T _frames[N];
+        };
+    } // namespace tools
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_TOOLS_SPSCRING_HPP
@@ -0,0 +1,160 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LEARNEMBEDDING_TOOLS_TORCHARCHIVE_HPP
+#define LEARNEMBEDDING_TOOLS_TORCHARCHIVE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace learn_embedding {
+    namespace tools {
+        /*
+            Reader for the parameters saved by TorchHelper.save (torch.save of a state_dict).
+
+            The archive is an uncompressed zip whose "<name>/data/<k>" entries hold the raw
+            float32 storages, numbered in the order the parameters appear in the state_dict.
+            Unpickling data.pkl is not needed as long as the caller knows the module layout.
+        */
+        class TorchArchive {
+        public:
+            TorchArchive() = default;
+
+            bool load(const std::string& path)
+            {
+                std::ifstream file(path, std::ios::binary);
+                if (!file.is_open()) {
+                    std::cerr << "Unable to open " << path << std::endl;
+                    return false;
+                }
+
+                _buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                _storages.clear();
+
+                // end of central directory record
+                if (_buffer.size() < 22)
+                    return error(path);
+                size_t eocd = _buffer.size() - 22;
+                while (eocd > 0 && read<uint32_t>(eocd) != 0x06054b50)
+                    eocd--;
+                if (read<uint32_t>(eocd) != 0x06054b50)
+                    return error(path);
+
+                size_t entries = read<uint16_t>(eocd + 10), offset = read<uint32_t>(eocd + 16);
+
+                for (size_t i = 0; i < entries; i++) {
+                    if (offset + 46 > _buffer.size() || read<uint32_t>(offset) != 0x02014b50)
+                        return error(path);
+
+                    uint16_t method = read<uint16_t>(offset + 10);
+                    uint32_t size = read<uint32_t>(offset + 20);
+                    size_t name_length = read<uint16_t>(offset + 28), extra_length = read<uint16_t>(offset + 30),
+                           comment_length = read<uint16_t>(offset + 32), header = read<uint32_t>(offset + 42);
+                    std::string name(&_buffer[offset + 46], name_length);
+                    offset += 46 + name_length + extra_length + comment_length;
+
+                    size_t pos = name.find("/data/");
+                    if (pos == std::string::npos || name.find("/.data/") != std::string::npos)
+                        continue;
+
+                    if (method != 0) {
+                        std::cerr << "Compressed storage " << name << " not supported" << std::endl;
+                        return false;
+                    }
+
+                    // skip local header
+                    size_t data = header + 30 + read<uint16_t>(header + 26) + read<uint16_t>(header + 28);
+                    if (data + size > _buffer.size())
+                        return error(path);
+
+                    Eigen::VectorXd storage(size / sizeof(float));
+                    for (Eigen::Index j = 0; j < storage.size(); j++)
+                        storage(j) = read<float>(data + j * sizeof(float));
+
+                    _storages[std::stoul(name.substr(pos + 6))] = storage;
+                }
+
+                _buffer.clear();
+
+                return true;
+            }
+
+            size_t size() const { return _storages.size(); }
+
+            // k-th storage as a (rows x cols) row-major tensor
+            bool tensor(const size_t& k, const Eigen::Index& rows, const Eigen::Index& cols, Eigen::MatrixXd& out) const
+            {
+                auto it = _storages.find(k);
+                if (it == _storages.end() || it->second.size() != rows * cols) {
+                    std::cerr << "Storage " << k << " does not match a " << rows << "x" << cols << " tensor" << std::endl;
+                    return false;
+                }
+
+                out = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(it->second.data(), rows, cols);
+
+                return true;
+            }
+
+            bool tensor(const size_t& k, const Eigen::Index& size, Eigen::VectorXd& out) const
+            {
+                auto it = _storages.find(k);
+                if (it == _storages.end() || it->second.size() != size) {
+                    std::cerr << "Storage " << k << " does not match a " << size << " vector" << std::endl;
+                    return false;
+                }
+
+                out = it->second;
+
+                return true;
+            }
+
+        protected:
+            template <typename T>
+            T read(const size_t& offset) const
+            {
+                T value;
+                std::memcpy(&value, &_buffer[offset], sizeof(T));
+                return value;
+            }
+
+            bool error(const std::string& path)
+            {
+                std::cerr << "Malformed torch archive " << path << std::endl;
+                return false;
+            }
+
+            std::vector<char> _buffer;
+            std::map<size_t, Eigen::VectorXd> _storages;
+        };
+    } // namespace tools
+} // namespace learn_embedding
+
+#endif // LEARNEMBEDDING_TOOLS_TORCHARCHIVE_HPP
@@ -34,14 +34,21 @@
 
 // Controllers
 #include <control_lib/controllers/Feedback.hpp>
-#include <control_lib/controllers/QuadraticControl.hpp>
 
 // CPP Utils
 #include <utils_lib/FileManager.hpp>
 #include <utils_lib/Timer.hpp>
 
+// Model
+#include "learn_embedding/model/FrankaModel.hpp"
+#include "learn_embedding/tools/Audit.hpp"
+#include "learn_embedding/tools/Logger.hpp"
+
+// Optimization
+#include "learn_embedding/optimization/InverseDynamics.hpp"
+
 // Stream
-#include <zmq_stream/Requester.hpp>
+#include "learn_embedding/stream/DynamicsStream.hpp"
 
 // parse yaml
 #include <yaml-cpp/yaml.h>
@@ -54,7 +61,7 @@ using namespace beautiful_bullet;
 using namespace control_lib;
 using namespace utils_lib;
 using namespace std::chrono;
-using namespace zmq_stream;
+using namespace learn_embedding;
 
 using R3 = spatial::R<3>;
 using R7 = spatial::R<7>;
@@ -69,20 +76,6 @@ struct ParamsConfig {
     struct feedback : public defaults::feedback {
         PARAM_SCALAR(size_t, d, 7);
     };
-
-    struct quadratic_control : public defaults::quadratic_control {
-        // State dimension
-        PARAM_SCALAR(size_t, nP, 7);
-
-        // Control/Input dimension (optimization torques)
-        PARAM_SCALAR(size_t, nC, 7);
-
-        // Slack variable dimension (optimization slack)
-        PARAM_SCALAR(size_t, nS, 6);
-
-        // derivative order (optimization joint acceleration)
-        PARAM_SCALAR(size_t, oD, 2);
-    };
 };
 
 struct ParamsTask {
@@ -95,33 +88,7 @@ struct ParamsTask {
     };
 };
 
-struct FrankaModel : public bodies::MultiBody {
-public:
-    FrankaModel() : bodies::MultiBody("rsc/franka/panda.urdf"), _frame("panda_joint_8"), _reference(pinocchio::LOCAL_WORLD_ALIGNED) {}
-
-    Eigen::MatrixXd jacobian(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobian(q, _frame, _reference);
-    }
-
-    Eigen::MatrixXd jacobianDerivative(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobianDerivative(q, dq, _frame, _reference);
-    }
-
-    Eigen::Matrix<double, 6, 1> framePose(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->framePose(q, _frame);
-    }
-
-    Eigen::Matrix<double, 6, 1> frameVelocity(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->frameVelocity(q, dq, _frame, _reference);
-    }
-
-    std::string _frame;
-    pinocchio::ReferenceFrame _reference;
-};
+using FrankaModel = learn_embedding::model::FrankaModel<7>;
 
 struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
     TaskDynamics()
@@ -141,7 +108,7 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
 
         // external ds stream
         _external = false;
-        _requester.configure("localhost", "5511");
+        _stream.configure("localhost", "5511");
     }
 
     TaskDynamics& setReference(const SE3& x)
@@ -163,6 +130,16 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
         return *this;
     }
 
+    TaskDynamics& setStream(const stream::Config& config)
+    {
+        _stream.configure(config);
+        return *this;
+    }
+
+    double replyAge() const { return _stream.age(); }
+
+    size_t replyMisses() const { return _stream.misses(); }
+
     const bool& external() { return _external; }
 
     void update(const SE3& x) override
@@ -173,7 +150,10 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
         Eigen::Matrix<double, 6, 1> state;
         state << p._x, p._v;
 
-        _u.head(3) = _external ? _requester.request<Eigen::VectorXd>(state, 3) : _pos(p);
+        if (_external && _stream.query(state, _reply))
+            _u.head(3) = _reply;
+        else
+            _u.head(3) = _pos(p);
 
         // orientation ds
         auto r = SO3(x._rot);
@@ -191,12 +171,13 @@ protected:
     controllers::Feedback<ParamsTask, SO3> _rot;
 
     bool _external;
-    Requester _requester;
+    stream::DynamicsStream<6, 3> _stream;
+    Eigen::Vector3d _reply;
 };
 
 struct IDController : public control::MultiBodyCtr {
-    IDController(const std::shared_ptr<FrankaModel>& model, const SE3& ref_pose)
-        : control::MultiBodyCtr(ControlMode::CONFIGURATIONSPACE), _ref_pose(ref_pose), _model(model)
+    IDController(const std::shared_ptr<FrankaModel>& model, const SE3& ref_pose, const stream::Config& link = stream::Config())
+        : control::MultiBodyCtr(ControlMode::CONFIGURATIONSPACE), _ref_pose(ref_pose), _model(model), _audit("IDController::action"), _record(false)
     {
         // configuration ds
         R7 curr_state(_model->state()),
@@ -211,13 +192,14 @@ struct IDController : public control::MultiBodyCtr {
             .update(curr_state);
 
         // torque reference
-        _ref_input = _model->gravityVector(curr_state._x);
+        _model->gravityVector(curr_state._x, _ref_input);
 
         // task ds
         SE3 curr_pose(_model->framePose(curr_state._x));
         curr_pose._v = _model->frameVelocity(curr_state._x, curr_state._v);
         _task
             .setReference(_ref_pose)
+            .setStream(link)
             .update(curr_pose);
 
         // inverse kinematics
@@ -228,6 +210,7 @@ struct IDController : public control::MultiBodyCtr {
 
         _id
             .setModel(_model)
+            .setTimeStep(ParamsConfig::controller::dt())
             .stateCost(Q)
             .inputCost(R)
             .inputReference(_ref_input)
@@ -239,17 +222,28 @@ struct IDController : public control::MultiBodyCtr {
             .velocityLimits()
             .accelerationLimits()
             .effortLimits()
-            .init(curr_state);
+            .init(curr_state._x, curr_state._v);
 
         // writer
         _writer.setFile("demo_id_0.csv");
     }
 
+    // Log the QP inputs of every tick (q, dq, task, state reference, input reference) for bench_qp
+    IDController& setRecord(const std::string& file)
+    {
+        _recorder.setFile(file);
+        _record = true;
+        return *this;
+    }
+
     Eigen::VectorXd action(bodies::MultiBody& body) override
     {
+        tools::Audit::Scope audit(_audit);
+
         // curr
         R7 curr_state(body.state());
         curr_state._v = body.velocity();
+        _model->update(curr_state._x, curr_state._v);
         SE3 curr_pose(_model->framePose(curr_state._x));
         curr_pose._v = _model->frameVelocity(curr_state._x, curr_state._v);
 
@@ -263,9 +257,18 @@ struct IDController : public control::MultiBodyCtr {
         {
             Timer timer;
             _config.update(curr_state);
-            _ref_input = _model->gravityVector(curr_state._x); // _ref_input = _model->nonLinearEffects(state._x, state._v);
+            _model->gravityVector(curr_state._x, _ref_input); // _ref_input = _model->nonLinearEffects(state._x, state._v);
             _task.update(curr_pose);
-            tau = _id(curr_state).segment(7, 7);
+            _id
+                .stateReference(_config.output())
+                .inputReference(_ref_input)
+                .inverseDynamics(_task.output());
+            tau = _id(curr_state._x, curr_state._v).segment(7, 7);
+        }
+
+        if (_record) {
+            _row << curr_state._x.transpose(), curr_state._v.transpose(), _task.output().transpose(), _config.output().transpose(), _ref_input.transpose();
+            _recorder.append(_row);
         }
 
         return tau;
@@ -280,11 +283,17 @@ struct IDController : public control::MultiBodyCtr {
     // task space ds
     TaskDynamics _task;
     // inverse dynamics
-    controllers::QuadraticControl<ParamsConfig, FrankaModel> _id;
+    optimization::InverseDynamics<7> _id;
     // model
     std::shared_ptr<FrankaModel> _model;
-    // file manager
-    FileManager _writer;
+    // allocations, locks and blocking io inside action
+    tools::Audit _audit;
+    // trajectory log, written by its own thread
+    tools::Logger<3> _writer;
+    // qp inputs
+    bool _record;
+    Eigen::Matrix<double, 1, 34> _row;
+    tools::Logger<34> _recorder;
 };
 
 int main(int argc, char const* argv[])
@@ -308,6 +317,11 @@ int main(int argc, char const* argv[])
     YAML::Node config = YAML::LoadFile("rsc/demos/" + demo + "/dynamics_params.yaml");
     auto offset = config["offset"].as<std::vector<double>>();
 
+    // ds transport (zmq, async, shm, native), the second argument overrides the demo configuration
+    stream::Config link("rsc/demos/" + demo, config["stream"]);
+    if (argc > 2)
+        link.setTransport(argv[2]);
+
     FileManager mng;
     std::vector<Eigen::MatrixXd> trajectories;
     for (size_t i = 1; i <= 7; i++) {
@@ -322,7 +336,11 @@ int main(int argc, char const* argv[])
     SE3 ref_pose(ref_rot, ref_pos);
     ref_pose._v.setZero();
 
-    auto controller = std::make_shared<IDController>(franka, ref_pose);
+    auto controller = std::make_shared<IDController>(franka, ref_pose, link);
+
+    // "record" as third argument logs the QP inputs for ./build/src/bench/bench_qp id qp_id.csv
+    if (argc > 3 && std::string(argv[3]) == "record")
+        controller->setRecord("qp_id.csv");
 
     // Set controlled robot
     (*franka)
@@ -34,18 +34,27 @@
 
 // Controllers
 #include <control_lib/controllers/Feedback.hpp>
-#include <control_lib/controllers/QuadraticControl.hpp>
 
 // CPP Utils
 #include <utils_lib/FileManager.hpp>
 #include <utils_lib/Timer.hpp>
 
+// Model
+#include "learn_embedding/model/FrankaModel.hpp"
+#include "learn_embedding/tools/Audit.hpp"
+#include "learn_embedding/tools/Logger.hpp"
+#include "learn_embedding/tools/MultiRate.hpp"
+
+// Optimization
+#include "learn_embedding/optimization/InverseKinematics.hpp"
+
 // Stream
-#include <zmq_stream/Requester.hpp>
+#include "learn_embedding/stream/DynamicsStream.hpp"
 
 // parse yaml
 #include <yaml-cpp/yaml.h>
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <thread>
@@ -54,7 +63,7 @@ using namespace beautiful_bullet;
 using namespace control_lib;
 using namespace utils_lib;
 using namespace std::chrono;
-using namespace zmq_stream;
+using namespace learn_embedding;
 
 using R3 = spatial::R<3>;
 using R7 = spatial::R<7>;
@@ -69,13 +78,6 @@ struct ParamsConfig {
     struct feedback : public defaults::feedback {
         PARAM_SCALAR(size_t, d, 7);
     };
-
-    struct quadratic_control : public defaults::quadratic_control {
-        PARAM_SCALAR(size_t, nP, 7); // State dimension
-        PARAM_SCALAR(size_t, nC, 0); // Control/Input dimension
-        PARAM_SCALAR(size_t, nS, 6); // Slack variable dimension
-        PARAM_SCALAR(size_t, oD, 1); // derivative order (optimization joint velocity)
-    };
 };
 
 struct ParamsTask {
@@ -88,34 +90,14 @@ struct ParamsTask {
     };
 };
 
-struct FrankaModel : public bodies::MultiBody {
-public:
-    FrankaModel() : bodies::MultiBody("rsc/franka/panda.urdf"), _frame("panda_joint_8"), _reference(pinocchio::LOCAL_WORLD_ALIGNED) {}
-
-    Eigen::MatrixXd jacobian(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobian(q, _frame, _reference);
-    }
-
-    Eigen::MatrixXd jacobianDerivative(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobianDerivative(q, dq, _frame, _reference);
-    }
-
-    Eigen::Matrix<double, 6, 1> framePose(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->framePose(q, _frame);
-    }
-
-    Eigen::Matrix<double, 6, 1> frameVelocity(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->frameVelocity(q, dq, _frame, _reference);
-    }
-
-    std::string _frame;
-    pinocchio::ReferenceFrame _reference;
+// Control period of the simulation loop (one controller action per simulator step)
+struct ParamsSimulation {
+    PARAM_SCALAR(double, dt, 1.0e-3);
 };
 
+using FrankaModel = learn_embedding::model::FrankaModel<7>;
+using Planner = learn_embedding::tools::MultiRate<7>;
+
 struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
     TaskDynamics()
     {
@@ -128,7 +110,7 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
 
         // external ds stream
         _external = false;
-        _requester.configure("localhost", "5511");
+        _stream.configure("localhost", "5511");
     }
 
     TaskDynamics& setReference(const SE3& x)
@@ -146,9 +128,22 @@ struct TaskDynamics : public controllers::AbstractController<ParamsTask, SE3> {
         return *this;
     }
 
+    TaskDynamics& setStream(const stream::Config& config)
+    {
+        _stream.configure(config);
+        return *this;
+    }
+
+    double replyAge() const { return _stream.age(); }
+
+    size_t replyMisses() const { return _stream.misses(); }
+
     void update(const SE3& x) override
     {
-        _u.head(3) = _external ? _requester.request<Eigen::VectorXd>(x._trans, 3) : _pos(R3(x._trans));
+        if (_external && _stream.query(x._trans, _reply))
+            _u.head(3) = _reply;
+        else
+            _u.head(3) = _pos(R3(x._trans));
 
         // _u.tail(3) = _rot(SO3(x._rot));
         _u.tail(3).setZero();
@@ -163,13 +158,21 @@ protected:
     controllers::Feedback<ParamsTask, SO3> _rot;
 
     bool _external;
-    Requester _requester;
+    stream::DynamicsStream<3, 3> _stream;
+    Eigen::Vector3d _reply;
 };
 
 struct IKController : public control::MultiBodyCtr {
-    IKController(const std::shared_ptr<FrankaModel>& model, const SE3& ref_pose)
-        : control::MultiBodyCtr(ControlMode::CONFIGURATIONSPACE), _ref_pose(ref_pose), _model(model)
+    // rate of the IK [Hz], 0 solves it inside every control tick
+    IKController(const std::shared_ptr<FrankaModel>& model, const SE3& ref_pose, const stream::Config& link = stream::Config(), const double& rate = 0.0)
+        : control::MultiBodyCtr(ControlMode::CONFIGURATIONSPACE), _ref_pose(ref_pose), _model(model), _audit("IKController::action"), _external(false), _multirate(rate > 0.0), _time(0.0), _record(false)
     {
+        // the IK thread evaluates the model on its own workspace
+        if (_multirate)
+            _planning = std::make_shared<FrankaModel::Workspace>(_model->workspace());
+        else
+            _planning = _model;
+
         // configuration ds
         R7 curr_state(_model->state()),
             ref_state((_model->positionUpper() - _model->positionLower()) * 0.5 + _model->positionLower());
@@ -182,6 +185,7 @@ struct IKController : public control::MultiBodyCtr {
         SE3 curr_pose(_model->framePose(curr_state._x));
         _task
             .setReference(_ref_pose)
+            .setStream(link)
             .update(curr_pose);
 
         // inverse kinematics
@@ -189,14 +193,17 @@ struct IKController : public control::MultiBodyCtr {
         Q.diagonal() << 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0;
         S.diagonal() << 10.0, 10.0, 10.0, 10.0, 10.0, 10.0;
         _ik
-            .setModel(_model)
+            .setModel(_planning)
+            // same position-limit horizon as exp_ik: the time a solution is followed
+            .setTimeStep(_multirate ? 1.0 / rate : ParamsConfig::controller::dt())
             .stateCost(Q)
             // .stateReference(_config.output())
             .slackCost(S)
             .inverseKinematics(_task.output())
             .positionLimits()
             .velocityLimits()
-            .init(curr_state);
+            .setCondensed(true)
+            .init(curr_state._x);
 
         // joints controller
         Eigen::MatrixXd K = Eigen::MatrixXd::Zero(7, 7), D = Eigen::MatrixXd::Zero(7, 7);
@@ -208,34 +215,89 @@ struct IKController : public control::MultiBodyCtr {
 
         // writer
         _writer.setFile("demo_ik_0.csv");
+
+        // from here on task ds and ik belong to the IK thread; waypoints lead their state by one controller step (see MultiRate)
+        if (_multirate)
+            _planner
+                .setPeriod(1.0 / rate)
+                .start(curr_state._x, _time, [this](const Planner::State& state, Planner::Reference& reference) {
+                    reference.dq = plan(state.q);
+                    reference.q = state.q + ParamsConfig::controller::dt() * reference.dq;
+                });
+    }
+
+    // Log the QP inputs of every IK solve (q, task, state reference) for bench_qp
+    IKController& setRecord(const std::string& file)
+    {
+        _recorder.setFile(file);
+        _record = true;
+        return *this;
+    }
+
+    ~IKController()
+    {
+        if (_multirate) {
+            _planner.stop();
+            _planner.latency().print("IKController::plan", std::cout);
+            std::cout << "IKController::plan overruns " << _planner.overruns() << " stalls " << _planner.stalls() << std::endl;
+        }
     }
 
     Eigen::VectorXd action(bodies::MultiBody& body) override
     {
+        tools::Audit::Scope audit(_audit);
+
         // curr
         R7 curr_state(body.state());
         curr_state._v = body.velocity();
+        _model->update(curr_state._x, curr_state._v);
         SE3 curr_pose(_model->framePose(curr_state._x));
 
-        if (_task.external())
+        if (_external)
             _writer.append(curr_pose._trans.transpose());
 
-        if ((curr_pose._trans - _ref_pose._trans).norm() <= 0.01 && !_task.external())
-            _task.setExternal(true);
+        if ((curr_pose._trans - _ref_pose._trans).norm() <= 0.01 && !_external)
+            _external = true;
 
         Eigen::Matrix<double, 7, 1> tau;
         {
             Timer timer;
-            // _config.update(state);
-            _task.update(curr_pose);
-            R7 ref_state(curr_state._x + ParamsConfig::controller::dt() * _ik(curr_state).segment(0, 7));
-            ref_state._v.setZero();
+            R7 ref_state;
+            if (_multirate) {
+                // joint impedance along the latest IK waypoint
+                _time += ParamsSimulation::dt();
+                _planner.update(curr_state._x, curr_state._v, _time);
+                ref_state._x = _planner.position();
+                ref_state._v = _planner.velocity();
+            }
+            else {
+                ref_state._x = curr_state._x + ParamsConfig::controller::dt() * plan(curr_state._x);
+                ref_state._v.setZero();
+            }
             tau = _ctr.setReference(ref_state).action(curr_state);
         }
 
         return tau;
     }
 
+    // Task ds and IK at q: joint velocity
+    Eigen::Matrix<double, 7, 1> plan(const Eigen::Matrix<double, 7, 1>& q)
+    {
+        if (_external && !_task.external())
+            _task.setExternal(true);
+
+        // _config.update(state);
+        _task.update(SE3(_planning->framePose(q)));
+
+        if (_record) {
+            _row << q.transpose(), _task.output().transpose(), Eigen::Matrix<double, 1, 7>::Zero();
+            _recorder.append(_row);
+        }
+
+        _ik.inverseKinematics(_task.output());
+        return _ik(q).segment(0, 7);
+    }
+
     // reference
     SE3 _ref_pose;
     // configuration space ds
@@ -243,13 +305,27 @@ struct IKController : public control::MultiBodyCtr {
     // task space ds
     TaskDynamics _task;
     // inverse dynamics
-    controllers::QuadraticControl<ParamsConfig, FrankaModel> _ik;
+    optimization::InverseKinematics<7> _ik;
     // joint space controller
     controllers::Feedback<ParamsConfig, R7> _ctr;
     // model
     std::shared_ptr<FrankaModel> _model;
-    // file manager
-    FileManager _writer;
+    // allocations, locks and blocking io inside action
+    tools::Audit _audit;
+    // trajectory log, written by its own thread
+    tools::Logger<3> _writer;
+    // model of task ds and ik (a separate workspace when they run on the IK thread)
+    std::shared_ptr<FrankaModel::Workspace> _planning;
+    // external ds switch, set by action and applied by the IK
+    std::atomic<bool> _external;
+    // IK thread and control time [s]
+    bool _multirate;
+    double _time;
+    // qp inputs (no state reference in this setup), the flag publishes the file to the IK thread
+    std::atomic<bool> _record;
+    Eigen::Matrix<double, 1, 20> _row;
+    tools::Logger<20> _recorder;
+    Planner _planner;
 };
 
 int main(int argc, char const* argv[])
@@ -273,6 +349,14 @@ int main(int argc, char const* argv[])
     YAML::Node config = YAML::LoadFile("rsc/demos/" + demo + "/dynamics_params.yaml");
     auto offset = config["offset"].as<std::vector<double>>();
 
+    // ds transport (zmq, async, shm, native), the second argument overrides the demo configuration
+    stream::Config link("rsc/demos/" + demo, config["stream"]);
+    if (argc > 2)
+        link.setTransport(argv[2]);
+
+    // IK rate [Hz] on its own thread, 0 solves it inside the 1 kHz control tick
+    double rate = (argc > 3) ? std::stod(argv[3]) : 1.0 / ParamsConfig::controller::dt();
+
     FileManager mng;
     std::vector<Eigen::MatrixXd> trajectories;
     for (size_t i = 1; i <= 7; i++) {
@@ -286,7 +370,11 @@ int main(int argc, char const* argv[])
     Eigen::Matrix3d ref_rot = (Eigen::Matrix3d() << 0.768647, 0.239631, 0.593092, 0.0948479, -0.959627, 0.264802, 0.632602, -0.147286, -0.760343).finished();
     SE3 ref_pose(ref_rot, ref_pos);
 
-    auto controller = std::make_shared<IKController>(franka, ref_pose);
+    auto controller = std::make_shared<IKController>(franka, ref_pose, link, rate);
+
+    // "record" as fourth argument logs the QP inputs for ./build/src/bench/bench_qp ik qp_ik.csv
+    if (argc > 4 && std::string(argv[4]) == "record")
+        controller->setRecord("qp_ik.csv");
 
     // Set controlled robot
     (*franka)
@@ -301,7 +389,7 @@ int main(int argc, char const* argv[])
     simulator.initGraphics();
 
     size_t index = 0;
-    double t = 0.0, dt = 1e-3, T = 40.0;
+    double t = 0.0, dt = ParamsSimulation::dt(), T = 40.0;
 
     auto next = steady_clock::now();
     auto prev = next - 1ms;
@@ -40,8 +40,13 @@
 #include <utils_lib/FileManager.hpp>
 #include <utils_lib/Timer.hpp>
 
+// Model
+#include "learn_embedding/model/FrankaModel.hpp"
+#include "learn_embedding/tools/Audit.hpp"
+#include "learn_embedding/tools/Logger.hpp"
+
 // Stream
-#include <zmq_stream/Requester.hpp>
+#include "learn_embedding/stream/DynamicsStream.hpp"
 
 // parse yaml
 #include <yaml-cpp/yaml.h>
@@ -54,7 +59,7 @@ using namespace beautiful_bullet;
 using namespace control_lib;
 using namespace utils_lib;
 using namespace std::chrono;
-using namespace zmq_stream;
+using namespace learn_embedding;
 
 using R3 = spatial::R<3>;
 using SE3 = spatial::SE<3>;
@@ -84,33 +89,7 @@ struct ParamsCTR {
     };
 };
 
-struct FrankaModel : public bodies::MultiBody {
-public:
-    FrankaModel() : bodies::MultiBody("rsc/franka/panda.urdf"), _frame("panda_joint_8"), _reference(pinocchio::LOCAL_WORLD_ALIGNED) {}
-
-    Eigen::MatrixXd jacobian(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobian(q, _frame, _reference);
-    }
-
-    Eigen::MatrixXd jacobianDerivative(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->jacobianDerivative(q, dq, _frame, _reference);
-    }
-
-    Eigen::Matrix<double, 6, 1> framePose(const Eigen::VectorXd& q)
-    {
-        return static_cast<bodies::MultiBody*>(this)->framePose(q, _frame);
-    }
-
-    Eigen::Matrix<double, 6, 1> frameVelocity(const Eigen::VectorXd& q, const Eigen::VectorXd& dq)
-    {
-        return static_cast<bodies::MultiBody*>(this)->frameVelocity(q, dq, _frame, _reference);
-    }
-
-    std::string _frame;
-    pinocchio::ReferenceFrame _reference;
-};
+using FrankaModel = learn_embedding::model::FrankaModel<7>;
 
 struct TaskDynamics : public controllers::AbstractController<ParamsDS, SE3> {
     TaskDynamics()
@@ -124,7 +103,7 @@ struct TaskDynamics : public controllers::AbstractController<ParamsDS, SE3> {
 
         // external ds stream
         _external = false;
-        _requester.configure("localhost", "5511");
+        _stream.configure("localhost", "5511");
     }
 
     TaskDynamics& setReference(const SE3& x)
@@ -142,10 +121,23 @@ struct TaskDynamics : public controllers::AbstractController<ParamsDS, SE3> {
         return *this;
     }
 
+    TaskDynamics& setStream(const stream::Config& config)
+    {
+        _stream.configure(config);
+        return *this;
+    }
+
+    double replyAge() const { return _stream.age(); }
+
+    size_t replyMisses() const { return _stream.misses(); }
+
     void update(const SE3& x) override
     {
         // position ds
-        _u.head(3) = _external ? _requester.request<Eigen::VectorXd>(x._trans, 3) : _pos(R3(x._trans));
+        if (_external && _stream.query(x._trans, _reply))
+            _u.head(3) = _reply;
+        else
+            _u.head(3) = _pos(R3(x._trans));
 
         // orientation ds
         // _u.tail(3) = _rot(SO3(x._rot));
@@ -161,15 +153,18 @@ protected:
     controllers::Feedback<ParamsDS, SO3> _rot;
 
     bool _external;
-    Requester _requester;
+    stream::DynamicsStream<3, 3> _stream;
+    Eigen::Vector3d _reply;
 };
 
 struct OperationSpaceController : public control::MultiBodyCtr {
-    OperationSpaceController(const std::shared_ptr<FrankaModel>& model, const SE3& ref_pose)
-        : control::MultiBodyCtr(ControlMode::CONFIGURATIONSPACE), _ref_pose(ref_pose), _model(model)
+    OperationSpaceController(const std::shared_ptr<FrankaModel>& model, const SE3& ref_pose, const stream::Config& link = stream::Config())
+        : control::MultiBodyCtr(ControlMode::CONFIGURATIONSPACE), _ref_pose(ref_pose), _model(model->workspace()), _consistent(false), _audit("OperationSpaceController::action")
     {
         // ds
-        _ds.setReference(_ref_pose);
+        _ds
+            .setReference(_ref_pose)
+            .setStream(link);
 
         // damping operation space control
         Eigen::Matrix<double, 6, 6> damping = Eigen::Matrix<double, 6, 6>::Zero();
@@ -180,11 +175,22 @@ struct OperationSpaceController : public control::MultiBodyCtr {
         _writer.setFile("demo_os_0.csv");
     }
 
+    // Dynamically consistent law tau = J^T Lambda F instead of tau = J^T F; M is refreshed every "tolerance" rad of motion
+    OperationSpaceController& setConsistent(const bool& consistent, const double& tolerance = 1e-3)
+    {
+        _consistent = consistent;
+        _model.setInertiaTolerance(tolerance);
+        return *this;
+    }
+
     Eigen::VectorXd action(bodies::MultiBody& body) override
     {
+        tools::Audit::Scope audit(_audit);
+
         // state
-        Eigen::VectorXd q = body.state(), dq = body.velocity();
-        SE3 curr_pose(_model->framePose(q));
+        Eigen::Matrix<double, 7, 1> q = body.state(), dq = body.velocity();
+        _model.update(q, dq);
+        SE3 curr_pose(_model.framePose(q));
 
         if (_ds.external())
             _writer.append(curr_pose._trans.transpose());
@@ -195,11 +201,14 @@ struct OperationSpaceController : public control::MultiBodyCtr {
         Eigen::Matrix<double, 7, 1> tau;
         {
             Timer timer;
-            Eigen::Matrix<double, 6, 7> jac = _model->jacobian(q);
-            curr_pose._v = jac * dq;
+            _model.jacobian(q, _jacobian);
+            curr_pose._v = _jacobian * dq;
             _ref_pose._v = _ds(curr_pose);
             _ctr.setReference(_ref_pose);
-            tau = jac.transpose() * _ctr(curr_pose);
+            _wrench = _ctr(curr_pose);
+            if (_consistent)
+                _wrench = _model.taskInertia(q) * _wrench;
+            tau = _jacobian.transpose() * _wrench;
         }
 
         return tau;
@@ -211,10 +220,15 @@ struct OperationSpaceController : public control::MultiBodyCtr {
     TaskDynamics _ds;
     // ctr
     controllers::Feedback<ParamsCTR, SE3> _ctr;
-    // model
-    std::shared_ptr<FrankaModel> _model;
-    // file manager
-    FileManager _writer;
+    // model (own workspace, the body's one belongs to the simulator)
+    FrankaModel::Workspace _model;
+    FrankaModel::Jacobian _jacobian;
+    Eigen::Matrix<double, 6, 1> _wrench;
+    bool _consistent;
+    // allocations, locks and blocking io inside action
+    tools::Audit _audit;
+    // trajectory log, written by its own thread
+    tools::Logger<3> _writer;
 };
 
 int main(int argc, char const* argv[])
@@ -238,6 +252,14 @@ int main(int argc, char const* argv[])
     YAML::Node config = YAML::LoadFile("rsc/demos/" + demo + "/dynamics_params.yaml");
     auto offset = config["offset"].as<std::vector<double>>();
 
+    // ds transport (zmq, async, shm, native), the second argument overrides the demo configuration
+    stream::Config link("rsc/demos/" + demo, config["stream"]);
+    if (argc > 2)
+        link.setTransport(argv[2]);
+
+    // "consistent" as third argument weights the task law with the operational-space inertia
+    bool consistent = argc > 3 && std::string(argv[3]) == "consistent";
+
     FileManager mng;
     std::vector<Eigen::MatrixXd> trajectories;
     for (size_t i = 1; i <= 7; i++) {
@@ -251,7 +273,8 @@ int main(int argc, char const* argv[])
     Eigen::Matrix3d ref_rot = (Eigen::Matrix3d() << 0.768647, 0.239631, 0.593092, 0.0948479, -0.959627, 0.264802, 0.632602, -0.147286, -0.760343).finished();
     SE3 ref_pose(ref_rot, ref_pos);
 
-    auto controller = std::make_shared<OperationSpaceController>(franka, ref_pose);
+    auto controller = std::make_shared<OperationSpaceController>(franka, ref_pose, link);
+    controller->setConsistent(consistent);
 
     // Set controlled robot
     (*franka)
@@ -0,0 +1,171 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Allocation audit of the learn_embedding calls made inside the controllers' action(): model workspace, ID and IK
+// programs (ADMM and condensed), native DS stream (first and second order), trajectory logger and multi-rate
+// reference, each driven per tick as sim_*/exp_* do. Allocations are counted in every build type here (locks and
+// blocking io too when configured with --audit); the remaining allocations of action() come from the external
+// libraries and are listed in the README.
+//
+// action_audit [demo] [ticks]
+// exits with 1 if any of these calls allocated (or locked or blocked)
+
+#define LEARNEMBEDDING_COUNT_ALLOCATIONS
+#include "learn_embedding/tools/Audit.hpp"
+
+// Model
+#include "learn_embedding/model/FrankaWorkspace.hpp"
+
+// Optimization
+#include "learn_embedding/optimization/InverseDynamics.hpp"
+#include "learn_embedding/optimization/InverseKinematics.hpp"
+
+// Stream
+#include "learn_embedding/stream/DynamicsStream.hpp"
+
+// Tools
+#include "learn_embedding/tools/Logger.hpp"
+#include "learn_embedding/tools/MultiRate.hpp"
+
+#include <iostream>
+#include <string>
+
+using namespace learn_embedding;
+
+using Workspace = model::FrankaWorkspace<7>;
+using Configuration = Workspace::Configuration;
+
+int main(int argc, char const* argv[])
+{
+    std::string demo = "rsc/demos/" + ((argc > 1) ? "demo_" + std::string(argv[1]) : std::string("demo_2"));
+    size_t num_ticks = (argc > 2) ? std::stoul(argv[2]) : 2000;
+
+    // inputs, moving every tick so that no cache is hit
+    auto workspace = std::make_shared<Workspace>();
+    const pinocchio::Model& pin = workspace->description()->model();
+    Configuration q = 0.5 * (pin.lowerPositionLimit + pin.upperPositionLimit), dq = Configuration::Constant(0.1), gravity, reference = q;
+    Eigen::Matrix<double, 6, 1> task = Eigen::Matrix<double, 6, 1>::Constant(0.01), state;
+    Eigen::Vector3d position, y;
+
+    // sim_id / sim_ik setups
+    optimization::InverseDynamics<7> id;
+    id.setModel(workspace)
+        .setTimeStep(1e-2)
+        .stateCost(Eigen::Matrix<double, 7, 7>::Identity())
+        .inputCost(0.1 * Eigen::Matrix<double, 7, 7>::Identity())
+        .inputReference(gravity)
+        .stateReference(reference)
+        .slackCost(70.0 * Eigen::Matrix<double, 6, 6>::Identity())
+        .modelConstraint()
+        .inverseDynamics(task)
+        .positionLimits()
+        .velocityLimits()
+        .accelerationLimits()
+        .effortLimits();
+
+    optimization::InverseKinematics<7> ik, condensed;
+    for (auto program : {&ik, &condensed})
+        program->setModel(workspace)
+            .setTimeStep(1e-2)
+            .stateCost(Eigen::Matrix<double, 7, 7>::Identity())
+            .stateReference(reference)
+            .slackCost(10.0 * Eigen::Matrix<double, 6, 6>::Identity())
+            .inverseKinematics(task)
+            .positionLimits()
+            .velocityLimits();
+    condensed.setCondensed(true);
+
+    // native ds, as with the `native` transport
+    stream::Config link;
+    link.transport = stream::Transport::NATIVE;
+    link.demo = demo;
+    stream::DynamicsStream<3, 3> first;
+    stream::DynamicsStream<6, 3> second;
+    if (first.configure(link).transport() != stream::Transport::NATIVE || second.configure(link).transport() != stream::Transport::NATIVE)
+        return 1;
+
+    tools::Logger<3> writer;
+    writer.setFile("/dev/null");
+
+    tools::MultiRate<7> planner;
+    planner.start(q, 0.0, [](const auto& current, auto& waypoint) {
+        waypoint.q = current.q;
+        waypoint.dq.setZero();
+    });
+
+    tools::Audit audits[] = {tools::Audit("FrankaWorkspace"), tools::Audit("InverseDynamics"), tools::Audit("InverseKinematics"),
+        tools::Audit("InverseKinematics condensed"), tools::Audit("DynamicsStream<3, 3> native"), tools::Audit("DynamicsStream<6, 3> native"),
+        tools::Audit("Logger::append"), tools::Audit("MultiRate::update")};
+
+    for (size_t i = 0; i < num_ticks; i++) {
+        q(0) += 1e-4;
+        {
+            tools::Audit::Scope audit(audits[0]);
+            workspace->update(q, dq);
+            position = workspace->framePose(q).head<3>();
+            state << position, workspace->frameVelocity(q, dq).head<3>();
+            workspace->gravityVector(q, gravity);
+        }
+        {
+            tools::Audit::Scope audit(audits[1]);
+            id.stateReference(reference).inputReference(gravity).inverseDynamics(task);
+            y = id(q, dq).segment<3>(7);
+        }
+        {
+            tools::Audit::Scope audit(audits[2]);
+            ik.stateReference(reference).inverseKinematics(task);
+            y = ik(q).head<3>();
+        }
+        {
+            tools::Audit::Scope audit(audits[3]);
+            condensed.stateReference(reference).inverseKinematics(task);
+            y = condensed(q).head<3>();
+        }
+        {
+            tools::Audit::Scope audit(audits[4]);
+            first.query(position, y);
+        }
+        {
+            tools::Audit::Scope audit(audits[5]);
+            second.query(state, y);
+        }
+        {
+            tools::Audit::Scope audit(audits[6]);
+            writer.append(position.transpose());
+        }
+        {
+            tools::Audit::Scope audit(audits[7]);
+            planner.update(q, dq, 1e-3 * i);
+        }
+    }
+    planner.stop();
+
+    bool clean = true;
+    for (const auto& audit : audits)
+        clean = clean && audit.clean();
+    std::cout << (clean ? "action() calls of learn_embedding: clean" : "action() calls of learn_embedding: NOT clean") << std::endl;
+
+    return clean ? 0 : 1;
+}
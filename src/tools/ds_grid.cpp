@@ -0,0 +1,120 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Sample the first order learned ds of a demo on a regular grid for the "grid" transport,
+// then report the interpolation error against the live model along the demo trajectories.
+//
+// ds_grid [demo] [resolution] [margin]
+// writes rsc/demos/demo_N/models/first_order.grid
+
+// Utils
+#include <utils_lib/FileManager.hpp>
+
+#include "learn_embedding/dynamics/FirstGeometry.hpp"
+#include "learn_embedding/dynamics/VoxelGrid.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+using namespace utils_lib;
+using namespace learn_embedding;
+using namespace std::chrono;
+
+int main(int argc, char const* argv[])
+{
+    std::string demo = "rsc/demos/" + ((argc > 1) ? "demo_" + std::string(argv[1]) : std::string("demo_2"));
+    uint32_t resolution = (argc > 2) ? std::stoul(argv[2]) : 64;
+    double margin = (argc > 3) ? std::stod(argv[3]) : 0.05;
+
+    // multilinear interpolation needs two nodes per axis
+    if (resolution < 2) {
+        std::cerr << "Resolution must be at least 2 nodes per axis" << std::endl;
+        return 1;
+    }
+
+    dynamics::FirstGeometry<3> ds;
+    if (!ds.load(demo))
+        return 1;
+
+    // demonstrations are stored relative to the attractor
+    FileManager mng;
+    Eigen::MatrixXd points(0, 3);
+    for (size_t i = 1; std::ifstream(demo + "/trajectory_" + std::to_string(i) + ".csv").good(); i++) {
+        Eigen::MatrixXd trajectory = mng.setFile(demo + "/trajectory_" + std::to_string(i) + ".csv").read<Eigen::MatrixXd>();
+        trajectory.rowwise() += ds.attractor().transpose();
+        points.conservativeResize(points.rows() + trajectory.rows(), 3);
+        points.bottomRows(trajectory.rows()) = trajectory;
+    }
+
+    if (!points.rows()) {
+        std::cerr << "No trajectories in " << demo << std::endl;
+        return 1;
+    }
+
+    // workspace: demonstrations and attractor plus a margin
+    Eigen::Vector3d lower = points.colwise().minCoeff().transpose().cwiseMin(ds.attractor()).array() - margin,
+                    upper = points.colwise().maxCoeff().transpose().cwiseMax(ds.attractor()).array() + margin;
+
+    dynamics::VoxelGrid<3> grid;
+    auto start = steady_clock::now();
+    if (!grid.sample(ds, lower, upper, Eigen::Matrix<uint32_t, 3, 1>::Constant(resolution)))
+        return 1;
+    std::cout << "Sampled " << resolution << "^3 nodes over [" << lower.transpose() << "] x [" << upper.transpose() << "] in "
+              << duration<double>(steady_clock::now() - start).count() << " s" << std::endl;
+
+    if (!grid.save(demo + "/models/first_order.grid"))
+        return 1;
+
+    // error report
+    Eigen::Vector3d y_model, y_grid;
+    double max_error = 0.0, squared_error = 0.0, max_speed = 0.0, model_time = 0.0, grid_time = 0.0;
+
+    for (Eigen::Index i = 0; i < points.rows(); i++) {
+        Eigen::Vector3d x = points.row(i).transpose();
+
+        start = steady_clock::now();
+        ds.evaluate(x, y_model);
+        model_time += duration<double, std::nano>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        grid.evaluate(x, y_grid);
+        grid_time += duration<double, std::nano>(steady_clock::now() - start).count();
+
+        double error = (y_grid - y_model).norm();
+        max_error = std::max(max_error, error);
+        squared_error += error * error;
+        max_speed = std::max(max_speed, y_model.norm());
+    }
+
+    std::cout << "Error along " << points.rows() << " demonstration points:"
+              << " max " << max_error
+              << " rms " << std::sqrt(squared_error / points.rows())
+              << " (max velocity " << max_speed << ")" << std::endl;
+    std::cout << "Mean evaluation time: model " << model_time / points.rows()
+              << " grid " << grid_time / points.rows() << " [ns]" << std::endl;
+
+    return 0;
+}
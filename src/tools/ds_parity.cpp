@@ -0,0 +1,46 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+
+// Check the native evaluator of a demo's learned ds against the python models: reference inputs and
+// outputs are dumped once by scripts/ds_golden.py into rsc/demos/demo_N/models/golden_{first,second}.csv.
+// Python evaluates in float32, so outputs must agree within tolerance * (1 + |y|) (default 1e-4). The exp_*
+// programs run the same check before the native transport may drive the robot.
+//
+// ds_parity [demo] [tolerance]
+// exits with 1 if a golden file is missing or any output exceeds the tolerance
+
+#include "learn_embedding/dynamics/Parity.hpp"
+
+#include <string>
+
+using namespace learn_embedding;
+
+int main(int argc, char const* argv[])
+{
+    std::string demo = "rsc/demos/" + ((argc > 1) ? "demo_" + std::string(argv[1]) : std::string("demo_2"));
+    double tolerance = (argc > 2) ? std::stod(argv[2]) : 1e-4;
+
+    return dynamics::parity<3>(demo, tolerance) ? 0 : 1;
+}
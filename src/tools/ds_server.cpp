@@ -0,0 +1,76 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Batching server of the learned ds, alternative to scripts/first_ds_control.py and scripts/second_ds_control.py
+// for any number of controllers (zmq/async transports), e.g. parallel sim_* rollouts or both arms of a dual setup.
+// Requests arriving within the window are evaluated together.
+//
+// ds_server [demo] [first|second] [port] [window us] [max requests per batch]
+
+// Stream
+#include "learn_embedding/dynamics/FirstGeometry.hpp"
+#include "learn_embedding/dynamics/SecondGeometry.hpp"
+#include "learn_embedding/stream/DynamicsServer.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <iostream>
+
+using namespace learn_embedding;
+
+std::atomic<bool> running(true);
+
+template <int In, int Out>
+int serve(dynamics::AbstractDynamics<In, Out>& ds, const std::string& port, const double& window, const size_t& capacity)
+{
+    stream::DynamicsServer<In, Out> server;
+    server.configure(port, window, capacity);
+    std::cout << "Serving on port " << port << std::endl;
+
+    while (running)
+        server.serve(ds);
+
+    server.print(std::cout);
+
+    return 0;
+}
+
+int main(int argc, char const* argv[])
+{
+    std::string demo = "rsc/demos/" + ((argc > 1) ? "demo_" + std::string(argv[1]) : std::string("demo_2")),
+                order = (argc > 2) ? argv[2] : "second",
+                port = (argc > 3) ? argv[3] : "5511";
+    double window = (argc > 4) ? 1e-6 * std::stod(argv[4]) : 2.0e-4;
+    size_t capacity = (argc > 5) ? std::stoul(argv[5]) : 64;
+
+    std::signal(SIGINT, [](int) { running = false; });
+
+    if (order == "first") {
+        dynamics::FirstGeometry<3> ds;
+        return ds.load(demo) ? serve(ds, port, window, capacity) : 1;
+    }
+
+    dynamics::SecondGeometry<3> ds;
+    return ds.load(demo) ? serve(ds, port, window, capacity) : 1;
+}
@@ -0,0 +1,106 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Deterministic stand-in for the python model server, no python/torch needed: serves an analytic linear ds
+// (first or second order) or the grid-cached first order ds of a demo over the same zmq protocol, with optional
+// reply latency, jitter and drop rate for reproducible benchmarks and latency-tolerance tests.
+//
+// ds_standin [demo] [linear|grid] [first|second] [port] [latency us] [jitter us] [drop rate] [seed]
+
+// Stream
+#include "learn_embedding/dynamics/Linear.hpp"
+#include "learn_embedding/dynamics/VoxelGrid.hpp"
+#include "learn_embedding/stream/DynamicsServer.hpp"
+
+#include <yaml-cpp/yaml.h>
+
+#include <atomic>
+#include <csignal>
+#include <iostream>
+
+using namespace learn_embedding;
+
+std::atomic<bool> running(true);
+
+struct Options {
+    std::string port;
+    double latency, jitter, drop;
+    uint64_t seed;
+};
+
+template <int In, int Out>
+int serve(dynamics::AbstractDynamics<In, Out>& ds, const Options& options)
+{
+    // no batching window: every request is answered on its own
+    stream::DynamicsServer<In, Out> server;
+    server.configure(options.port, 0.0, 1).setFaults(options.latency, options.jitter, options.drop, options.seed);
+    std::cout << "Serving on port " << options.port << std::endl;
+
+    while (running)
+        server.serve(ds);
+
+    server.print(std::cout);
+
+    return 0;
+}
+
+int main(int argc, char const* argv[])
+{
+    std::string demo = "rsc/demos/" + ((argc > 1) ? "demo_" + std::string(argv[1]) : std::string("demo_2")),
+                field = (argc > 2) ? argv[2] : "linear",
+                order = (argc > 3) ? argv[3] : "second";
+
+    Options options;
+    options.port = (argc > 4) ? argv[4] : "5511";
+    options.latency = (argc > 5) ? 1e-6 * std::stod(argv[5]) : 0.0;
+    options.jitter = (argc > 6) ? 1e-6 * std::stod(argv[6]) : 0.0;
+    options.drop = (argc > 7) ? std::stod(argv[7]) : 0.0;
+    options.seed = (argc > 8) ? std::stoull(argv[8]) : 0;
+
+    std::signal(SIGINT, [](int) { running = false; });
+
+    YAML::Node config = YAML::LoadFile(demo + "/dynamics_params.yaml");
+    auto offset = config["offset"].as<std::vector<double>>();
+    Eigen::Vector3d attractor = Eigen::Map<Eigen::Vector3d>(offset.data());
+
+    if (field == "grid") {
+        if (order != "first") {
+            std::cerr << "The grid only caches the first order ds" << std::endl;
+            return 1;
+        }
+        dynamics::VoxelGrid<3> ds;
+        return ds.load(demo + "/models/first_order.grid") ? serve(ds, options) : 1;
+    }
+
+    // gains of the local ds of TaskDynamics in sim_id
+    if (order == "first") {
+        dynamics::Linear<3, 3> ds;
+        ds.setAttractor(attractor).setStiffness(3.0);
+        return serve(ds, options);
+    }
+
+    dynamics::Linear<6, 3> ds;
+    ds.setAttractor(attractor).setStiffness(3.0).setDamping(2.0 * std::sqrt(3.0));
+    return serve(ds, options);
+}
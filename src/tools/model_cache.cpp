@@ -0,0 +1,88 @@
+/*
+    This file is part of demo-learn-embedding.
+
+    Copyright (c) 2021, 2022 Bernardo Fichera <bernardo.fichera@gmail.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+// Prebuild the pinocchio model caches of the Franka robots (see learn_embedding/model/ModelCache.hpp) so that
+// controllers and sweep workers skip urdf parsing at startup. A missing urdf is first generated from its xacro.
+//
+// model_cache [urdf ...]
+// default: panda, fr3 and dual_panda; writes <urdf>.<hash>.bin next to each urdf
+
+#include "learn_embedding/model/ModelCache.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+using namespace learn_embedding;
+using namespace std::chrono;
+
+int main(int argc, char const* argv[])
+{
+    // urdf and the xacro it is generated from
+    std::vector<std::pair<std::string, std::string>> robots;
+    for (int i = 1; i < argc; i++)
+        robots.push_back({argv[i], ""});
+    if (robots.empty())
+        robots = {
+            {"rsc/franka/panda.urdf", ""},
+            {"rsc/franka/robots/fr3/fr3.urdf", "rsc/franka/robots/fr3/fr3.urdf.xacro"},
+            {"rsc/franka/robots/dual_panda/dual_panda.urdf", "rsc/franka/robots/dual_panda/dual_panda_example.urdf.xacro"},
+        };
+
+    int status = 0;
+
+    for (const auto& [urdf, xacro] : robots) {
+        if (!std::ifstream(urdf).good() && !xacro.empty()) {
+            std::cout << "Generating " << urdf << " from " << xacro << std::endl;
+            if (std::system(("xacro " + xacro + " > " + urdf).c_str()) != 0)
+                std::remove(urdf.c_str());
+        }
+
+        pinocchio::Model model;
+        auto start = steady_clock::now();
+        if (!model::ModelCache::build(urdf, model)) {
+            status = 1;
+            continue;
+        }
+        double build_time = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        model = pinocchio::Model();
+        start = steady_clock::now();
+        pinocchio::urdf::buildModel(urdf, model);
+        double parse_time = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        model = pinocchio::Model();
+        start = steady_clock::now();
+        model::ModelCache::build(urdf, model);
+        double load_time = duration<double, std::milli>(steady_clock::now() - start).count();
+
+        std::cout << urdf << ": " << model.nv << " dofs, build " << build_time << " ms, parse " << parse_time << " ms, cached load "
+                  << load_time << " ms" << std::endl;
+    }
+
+    return status;
+}